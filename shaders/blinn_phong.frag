@@ -1,6 +1,16 @@
 //FRAGMENT_SHADER
 #version 460 core
+#include "ubo_frame.glsl"
 #include "ssbo_light_data.glsl"
+#if CLUSTERED_SHADING
+#include "ssbo_clusters.glsl"
+#endif
+#if SPARSE_SHADOWS
+#include "ssbo_shadow_pages.glsl"
+// Page requests are a side effect, which would otherwise make the depth test run after the shader. This shader never
+// discards or writes depth, so testing early is safe, and occluded fragments neither shade nor request pages.
+layout (early_fragment_tests) in;
+#endif
 
 in VS_OUT {
     flat int material_index;
@@ -11,40 +21,59 @@ in VS_OUT {
     flat mat3 TBN;
 } fs_in;
 
-layout (binding = SAMPLER_ARRAY_TEMPLE) uniform sampler2DArray model_texture_array;
+layout (binding = SAMPLER_ARRAY_TEMPLE_DIFFUSE) uniform sampler2DArray diffuse_array;
+layout (binding = SAMPLER_ARRAY_TEMPLE_NORMAL) uniform sampler2DArray normal_array;
+layout (binding = SAMPLER_ARRAY_TEMPLE_SPECULAR) uniform sampler2DArray specular_array;
 layout (binding = SAMPLER_ARRAY_SHADOW_SUN) uniform sampler2DArrayShadow sunlight_csm_array;
 
 const float SPECULAR_EXPONENT = 16.0;
-const float POINT_LIGHT_MAX_R = 7.0;
 const vec3 AMBIENT_LIGHT = vec3(1.0);
 
 out vec4 frag_color;
 
 float calculateShadow();
+vec3 calculatePointLight(Light light, vec3 N, vec3 V, vec3 diffuse_color, float specular_factor);
 vec3 calculateBlinnPhong(vec3 L, vec3 N, vec3 V, vec3 diffuse_color, vec3 light_color, float specular_factor);
 float calculateAttenuation(float intensity, float source_distance);
 
 void main() {
-    vec3 raw_diffuse = texture(model_texture_array, vec3(fs_in.uv, float(fs_in.material_index * 3))).rgb;
-    vec3 raw_normal = texture(model_texture_array, vec3(fs_in.uv, float(fs_in.material_index * 3 + 1))).xyz;
-    float raw_specular = texture(model_texture_array, vec3(fs_in.uv, float(fs_in.material_index * 3 + 2))).r;
+#if PACKED_MATERIALS
+    vec4 diffuse_specular = texture(diffuse_array, vec3(fs_in.uv, float(fs_in.material_index)));
+    vec3 raw_diffuse = diffuse_specular.rgb;
+    float raw_specular = diffuse_specular.a;
+#else
+    vec3 raw_diffuse = texture(diffuse_array, vec3(fs_in.uv, float(fs_in.material_index))).rgb;
+    float raw_specular = texture(specular_array, vec3(fs_in.uv, float(fs_in.material_index))).r;
+#endif
+#if COMPRESSED_TEXTURES || PACKED_MATERIALS
+    // Only x and y are stored, z is reconstructed from the unit length
+    vec2 normal_xy = texture(normal_array, vec3(fs_in.uv, float(fs_in.material_index))).xy * 2.0 - 1.0;
+    vec3 tangent_normal = vec3(normal_xy, sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));
+#else
+    vec3 tangent_normal = texture(normal_array, vec3(fs_in.uv, float(fs_in.material_index))).xyz * 2.0 - 1.0;
+#endif
 
     vec3 diffuse_color = pow(raw_diffuse, vec3(2.2));
     float specular_factor = 1.0 - pow(1.0 - raw_specular, 2.0);
-    vec3 N = normalize(fs_in.TBN * (raw_normal * 2.0 - 1.0));
+    vec3 N = normalize(fs_in.TBN * tangent_normal);
     vec3 V = normalize(camera.world_space_position.xyz - fs_in.world_space_position.xyz);
 
     vec3 final_color = AMBIENT_LIGHT * diffuse_color;
     final_color += calculateShadow() * sunlight.intensity * calculateBlinnPhong(
         normalize(sunlight.source.xyz), N, V, diffuse_color, sunlight.color.rgb, specular_factor
     );
+#if CLUSTERED_SHADING
+    uint cluster_index = getClusterIndex(gl_FragCoord.xy, -fs_in.view_space_position.z);
+    uint light_offset = clusters[cluster_index].light_offset;
+    for (uint i = 0; i < clusters[cluster_index].light_count; ++i) {
+        Light light = point_lights[cluster_light_indices[light_offset + i]];
+        final_color += calculatePointLight(light, N, V, diffuse_color, specular_factor);
+    }
+#else
     for (int i = 0; i < num_point_lights; ++i) {
-        vec3 relative_light_position = point_lights[i].source.xyz - fs_in.world_space_position.xyz;
-        float attenuation = calculateAttenuation(point_lights[i].intensity, length(relative_light_position));
-        final_color += attenuation * calculateBlinnPhong(
-            normalize(relative_light_position), N, V, diffuse_color, point_lights[i].color.rgb, specular_factor
-        );
+        final_color += calculatePointLight(point_lights[i], N, V, diffuse_color, specular_factor);
     }
+#endif
 
     frag_color = vec4(final_color, 1.0);
 }
@@ -63,9 +92,24 @@ float calculateShadow() {
     vec3 remapped_position =
         (fs_in.sunlight_space_position[layer].xyz / fs_in.sunlight_space_position[layer].w) * 0.5 + 0.5;
     float bias = (layer == 0) ? 0.0001 : 0.0005;
+#if SPARSE_SHADOWS
+    // Pages that have not been committed yet are treated as lit until the next frame
+    if (all(greaterThanEqual(remapped_position.xy, vec2(0.0))) && all(lessThan(remapped_position.xy, vec2(1.0)))
+        && !requestShadowPage(remapped_position.xy, layer)) {
+        return 1.0;
+    }
+#endif
     return texture(sunlight_csm_array, vec4(remapped_position.xy, layer, remapped_position.z - bias));
 }
 
+vec3 calculatePointLight(Light light, vec3 N, vec3 V, vec3 diffuse_color, float specular_factor) {
+    vec3 relative_light_position = light.source.xyz - fs_in.world_space_position.xyz;
+    float attenuation = calculateAttenuation(light.intensity, length(relative_light_position));
+    return attenuation * calculateBlinnPhong(
+        normalize(relative_light_position), N, V, diffuse_color, light.color.rgb, specular_factor
+    );
+}
+
 vec3 calculateBlinnPhong(vec3 L, vec3 N, vec3 V, vec3 diffuse_color, vec3 light_color, float specular_factor) {
     vec3 diffuse = light_color * max(dot(N, L), 0.0);
     vec3 H = normalize(L + V); // halfway vector
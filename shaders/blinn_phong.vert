@@ -1,7 +1,7 @@
 //VERTEX_SHADER
 #version 460 core
 #include "ssbo_temple_vertex.glsl"
-#include "ubo_matrices.glsl"
+#include "ubo_frame.glsl"
 
 out VS_OUT {
     flat int material_index;
@@ -1,7 +1,12 @@
 //VERTEX_SHADER
 #version 460 core
+#extension GL_ARB_shader_viewport_layer_array : require
 #include "ssbo_temple_vertex.glsl"
+#include "ubo_frame.glsl"
 
+// Draw commands are emitted by csm_cull.comp, with one instance per cascade starting at cascade gl_BaseInstance
 void main() {
-    gl_Position = vec4(getPosition(gl_VertexID), 1.0);
-}
\ No newline at end of file
+    int cascade = gl_BaseInstance + gl_InstanceID;
+    gl_Layer = cascade;
+    gl_Position = sunlight_transform[cascade] * vec4(getPosition(gl_VertexID), 1.0);
+}
@@ -0,0 +1,35 @@
+//INCLUDE_TARGET
+// Extracts the six clip planes (left, right, bottom, top, near, far) of a view-projection matrix. The planes are not
+// normalized, which is fine for the sign tests below.
+void getFrustumPlanes(mat4 view_projection, out vec4 planes[6]) {
+    mat4 m = transpose(view_projection);
+    planes[0] = m[3] + m[0];
+    planes[1] = m[3] - m[0];
+    planes[2] = m[3] + m[1];
+    planes[3] = m[3] - m[1];
+    planes[4] = m[3] + m[2];
+    planes[5] = m[3] - m[2];
+}
+
+bool isBoxInFrustum(vec3 min_point, vec3 max_point, vec4 planes[6]) {
+    for (int i = 0; i < 6; ++i) {
+        // Test the corner of the box that lies furthest along the plane normal
+        vec3 furthest_corner = mix(min_point, max_point, greaterThanEqual(planes[i].xyz, vec3(0.0)));
+        if (dot(planes[i].xyz, furthest_corner) + planes[i].w < 0.0) return false;
+    }
+    return true;
+}
+
+// True if the screen space rectangle of the box contains no pixel center, so nothing inside it can be rasterized
+bool isBoxBetweenPixelCenters(vec3 min_point, vec3 max_point, mat4 view_projection, vec2 screen_size) {
+    vec2 pixel_min = screen_size;
+    vec2 pixel_max = vec2(0.0);
+    for (int i = 0; i < 8; ++i) {
+        vec4 clip_position = view_projection * vec4(mix(min_point, max_point, bvec3(i & 1, i & 2, i & 4)), 1.0);
+        if (clip_position.w <= 0.0) return false;
+        vec2 pixel = (clip_position.xy / clip_position.w * 0.5 + 0.5) * screen_size;
+        pixel_min = min(pixel_min, pixel);
+        pixel_max = max(pixel_max, pixel);
+    }
+    return any(equal(round(pixel_min), round(pixel_max)));
+}
@@ -1,7 +1,7 @@
 //VERTEX_SHADER
 #version 460 core
 #include "ssbo_sky_vertex.glsl"
-#include "ubo_matrices.glsl"
+#include "ubo_frame.glsl"
 out VS_OUT {
     vec4 model_space_position;
 } vs_out;
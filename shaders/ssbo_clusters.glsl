@@ -0,0 +1,33 @@
+//INCLUDE_TARGET
+// This should match the layout described in src/renderer.h
+struct Cluster {
+    vec4 min_point; // view space AABB
+    vec4 max_point;
+    uint light_offset;
+    uint light_count;
+};
+struct VisibleLight {
+    vec3 view_space_position;
+    uint index;
+};
+layout (binding = SSBO_CLUSTER, std430) buffer cluster_ssbo {
+    vec2 screen_size;
+    float z_near;
+    float z_far;
+    uint num_visible_lights;
+    uint light_index_count;
+    Cluster clusters[CLUSTER_COUNT];
+    VisibleLight visible_lights[];
+};
+layout (binding = SSBO_CLUSTER_LIGHT_INDEX, std430) buffer cluster_light_index_ssbo {
+    uint cluster_light_indices[];
+};
+
+// Depth slices are distributed exponentially, so that clusters are roughly cube-shaped in view space
+uint getClusterIndex(vec2 frag_coord, float view_depth) {
+    uint slice = uint(max(log(view_depth / z_near) / log(z_far / z_near) * CLUSTER_GRID_Z, 0.0));
+    uvec2 tile = uvec2(frag_coord / screen_size * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y));
+    tile = min(tile, uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+    slice = min(slice, CLUSTER_GRID_Z - 1);
+    return tile.x + tile.y * CLUSTER_GRID_X + slice * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+}
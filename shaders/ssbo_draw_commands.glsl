@@ -0,0 +1,102 @@
+//INCLUDE_TARGET
+// This should match the definitions in src/model.h
+struct DrawCommand {
+    uint count;
+    uint instance_count;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+struct DrawBounds {
+    vec4 min_point;
+    vec4 max_point;
+};
+struct DrawCone {
+    vec4 sphere; // center, radius
+    vec4 cone;   // axis, cutoff
+};
+struct DrawLod {
+    uint num_levels;
+    uint first_index[DRAW_LOD_MAX_LEVELS];
+    uint count[DRAW_LOD_MAX_LEVELS];
+    float error[DRAW_LOD_MAX_LEVELS];
+};
+layout (binding = SSBO_DRAW_BOUNDS, std430) readonly buffer draw_bounds_ssbo {
+    DrawBounds draw_bounds[];
+};
+layout (binding = SSBO_DRAW_CONE, std430) readonly buffer draw_cone_ssbo {
+    DrawCone draw_cones[];
+};
+layout (binding = SSBO_DRAW_LOD, std430) readonly buffer draw_lod_ssbo {
+    DrawLod draw_lods[];
+};
+layout (binding = SSBO_DRAW_COMMAND, std430) readonly buffer draw_command_ssbo {
+    DrawCommand draw_commands[];
+};
+layout (binding = SSBO_CULLED_DRAW_COMMAND, std430) writeonly buffer culled_draw_command_ssbo {
+    DrawCommand culled_draw_commands[];
+};
+layout (binding = SSBO_DRAW_COUNT, std430) buffer draw_count_ssbo {
+    uint culled_draw_count;
+};
+layout (binding = SSBO_DRAW_VISIBILITY, std430) buffer draw_visibility_ssbo {
+    uint draw_visibility[]; // persists between frames
+};
+
+void appendCulledDrawCommand(DrawCommand command) {
+    culled_draw_commands[atomicAdd(culled_draw_count, 1)] = command;
+}
+
+shared DrawCommand group_commands[DRAW_CULL_GROUP_SIZE];
+shared bool group_appends[DRAW_CULL_GROUP_SIZE];
+
+// True if command b draws the indices right after those of command a, with the same vertices and instances
+bool isDrawCommandContinued(DrawCommand a, DrawCommand b) {
+    return a.first_index + a.count == b.first_index && a.base_vertex == b.base_vertex &&
+           a.instance_count == b.instance_count && a.base_instance == b.base_instance;
+}
+
+// Appends the command of every invocation in the work group that sets append, merging each run of commands that
+// continue one another (such as neighbouring meshlets) into one. Every invocation must call this, in uniform control
+// flow.
+void appendMergedDrawCommand(bool append, DrawCommand command) {
+    uint i = gl_LocalInvocationIndex;
+    group_commands[i] = command;
+    group_appends[i] = append;
+    memoryBarrierShared();
+    barrier();
+    if (!append || (i > 0 && group_appends[i - 1] && isDrawCommandContinued(group_commands[i - 1], command))) return;
+    for (uint j = i + 1; j < DRAW_CULL_GROUP_SIZE && group_appends[j]; ++j) {
+        if (!isDrawCommandContinued(group_commands[j - 1], group_commands[j])) break;
+        command.count += group_commands[j].count;
+    }
+    appendCulledDrawCommand(command);
+}
+
+// True if every triangle of the draw faces away from the viewer
+bool isDrawBackfacing(uint draw_index, vec3 viewer_position) {
+    DrawCone draw_cone = draw_cones[draw_index];
+    vec3 offset = draw_cone.sphere.xyz - viewer_position;
+    return dot(offset, draw_cone.cone.xyz) >= draw_cone.cone.w * length(offset) + draw_cone.sphere.w;
+}
+
+// Pixels covered by one world unit at the nearest point of the draw's bounding sphere (needs ubo_frame.glsl)
+float getPixelsPerUnit(uint draw_index) {
+    vec4 sphere = draw_cones[draw_index].sphere;
+    float sphere_distance = max(distance(sphere.xyz, camera.world_space_position.xyz) - sphere.w, 1e-3);
+    return projection[1][1] * viewport_size.y * 0.5 / sphere_distance;
+}
+
+// Returns the draw command using its coarsest level of detail whose error, scaled by error_scale, is at most max_error
+DrawCommand getLodDrawCommand(uint draw_index, float error_scale, float max_error) {
+    DrawCommand command = draw_commands[draw_index];
+#if LOD_SELECTION
+    uint level = 0;
+    for (uint i = 1; i < draw_lods[draw_index].num_levels; ++i) {
+        if (draw_lods[draw_index].error[i] * error_scale <= max_error) level = i;
+    }
+    command.first_index = draw_lods[draw_index].first_index[level];
+    command.count = draw_lods[draw_index].count[level];
+#endif
+    return command;
+}
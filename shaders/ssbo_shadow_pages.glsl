@@ -0,0 +1,18 @@
+//INCLUDE_TARGET
+layout (binding = SSBO_SHADOW_PAGE_RESIDENCY, std430) readonly buffer shadow_page_residency_ssbo {
+    uvec2 shadow_page_grid; // number of pages along x and y, per cascade
+    uint shadow_page_residency[];
+};
+layout (binding = SSBO_SHADOW_PAGE_REQUEST, std430) writeonly buffer shadow_page_request_ssbo {
+    uint shadow_page_requests[];
+};
+
+/**
+ * Flags the page containing uv as needed this frame, and returns whether it is currently backed by memory.
+ */
+bool requestShadowPage(vec2 uv, int layer) {
+    uvec2 page = min(uvec2(uv * vec2(shadow_page_grid)), shadow_page_grid - 1u);
+    uint page_index = (uint(layer) * shadow_page_grid.y + page.y) * shadow_page_grid.x + page.x;
+    shadow_page_requests[page_index] = 1u;
+    return shadow_page_residency[page_index] != 0u;
+}
@@ -1,5 +1,45 @@
 //INCLUDE_TARGET
-// This should match the definition in src/model.h
+// This should match the definitions in src/model.h
+#if COMPRESSED_VERTICES
+struct Vertex {
+    uint position[2]; // 21 bits per axis
+    uint tangent;     // octahedral, snorm16x2
+    uint bitangent;   // octahedral, snorm16x2
+    uint uv;          // half2x16
+};
+layout (binding = SSBO_TEMPLE_VERTEX, std430) readonly buffer temple_vertex_ssbo {
+    vec4 position_min;
+    vec4 position_step;
+    Vertex data[];
+};
+
+vec3 getPosition(int index) {
+    uint low = data[index].position[0];
+    uint high = data[index].position[1];
+    uvec3 quantized = uvec3(low & 0x1FFFFFu, (low >> 21) | ((high & 0x3FFu) << 11), high >> 10);
+    return position_min.xyz + vec3(quantized) * position_step.xyz;
+}
+
+vec3 decodeOctahedral(uint encoded) {
+    vec2 e = unpackSnorm2x16(encoded);
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * mix(vec2(-1.0), vec2(1.0), greaterThanEqual(v.xy, vec2(0.0)));
+    }
+    return normalize(v);
+}
+
+mat3 getTBN(int index) {
+    vec3 T = decodeOctahedral(data[index].tangent);
+    vec3 B = decodeOctahedral(data[index].bitangent);
+    vec3 N = cross(T, B);
+    return mat3(T, B, N);
+}
+
+vec2 getUV(int index) {
+    return unpackHalf2x16(data[index].uv);
+}
+#else
 struct Vertex {
     float position[3];
     float tangent[3];
@@ -30,4 +70,5 @@ mat3 getTBN(int index) {
 vec2 getUV(int index) {
     return vec2(data[index].uv[0],
                 data[index].uv[1]);
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+//INCLUDE_TARGET
+struct CameraParameters {
+    vec4 world_space_position;
+    vec4 csm_partition_depths; // far plane view depth of each cascade, in x, y and z
+};
+layout (binding = UBO_FRAME, std140) uniform frame_ubo { // rewritten every frame, see Renderer::FrameData
+    mat4 projection;
+    mat4 view;
+    mat4 sunlight_transform[3];
+    uint csm_update_mask; // bit i is set if cascade i is re-rendered this frame
+    vec2 viewport_size;
+    float lod_pixel_error; // largest projected error allowed when choosing a level of detail
+    CameraParameters camera;
+};
\ No newline at end of file
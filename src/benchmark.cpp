@@ -0,0 +1,43 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <utility>
+
+Benchmark::Benchmark(CameraPath path, const GLuint warmup_frames)
+  : path_ {std::move(path)}, warmup_frames_ {warmup_frames}, measured_frames_ {path_.getNumFrames()} {
+  frame_ms_.reserve(measured_frames_);
+}
+
+CameraPath::Pose Benchmark::getPose() const {
+  return path_.getPose(path_.getFrameTime(isWarmingUp() ? 0 : frame_ - warmup_frames_));
+}
+
+void Benchmark::endFrame() {
+  const auto now {std::chrono::steady_clock::now()};
+  if (!isWarmingUp() && !isFinished()) {
+    frame_ms_.push_back(std::chrono::duration<double, std::milli>(now - last_frame_end_).count());
+  }
+  last_frame_end_ = now;
+  ++frame_;
+}
+
+Benchmark::Summary Benchmark::summarize() const {
+  std::vector sorted {frame_ms_};
+  std::ranges::sort(sorted);
+  const auto percentile {[&sorted](const size_t p) { return sorted[(sorted.size() * p + 99) / 100 - 1]; }};
+  double sum {0.0};
+  for (const double sample : sorted) { sum += sample; }
+
+  /// The slowest 1% of frames, but at least one
+  const size_t num_slowest {std::max<size_t>(sorted.size() / 100, 1)};
+  double slowest_sum {0.0};
+  for (size_t i = sorted.size() - num_slowest; i < sorted.size(); ++i) { slowest_sum += sorted[i]; }
+
+  return {sum / static_cast<double>(sorted.size()),
+          percentile(50),
+          percentile(95),
+          percentile(99),
+          sorted.front(),
+          sorted.back(),
+          1000.0 * static_cast<double>(num_slowest) / slowest_sum};
+}
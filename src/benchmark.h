@@ -0,0 +1,59 @@
+#ifndef TEMPLEGL_SRC_BENCHMARK_H_
+#define TEMPLEGL_SRC_BENCHMARK_H_
+
+#include "camera_path.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <chrono>
+
+/**
+ * Drives a benchmark run: moves the camera along a CameraPath once, and collects the duration of every frame after a
+ * number of warm-up frames. The path is sampled at fixed time steps, so every run renders exactly the same frames.
+ */
+class Benchmark {
+public:
+  struct Summary { // all times in milliseconds
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double min;
+    double max;
+    double one_percent_low_fps; // frame rate over the slowest 1% of frames
+  };
+
+  /**
+   * @param warmup_frames   At least one, since the first frame has no previous frame to be timed against.
+   */
+  Benchmark(CameraPath path, GLuint warmup_frames);
+
+  /**
+   * @returns   The camera pose of the current frame. Warm-up frames stay at the start of the path.
+   */
+  [[nodiscard]] CameraPath::Pose getPose() const;
+
+  /**
+   * Must be called at the same point of every frame. Records the time since the previous call, once warm-up is over.
+   */
+  void endFrame();
+
+  [[nodiscard]] bool isWarmingUp() const { return frame_ < warmup_frames_; }
+  [[nodiscard]] bool isFinished() const { return frame_ >= warmup_frames_ + measured_frames_; }
+  [[nodiscard]] GLuint getMeasuredFrames() const { return measured_frames_; } // one per time step along the path
+
+  /**
+   * Percentiles use the nearest rank method. Must only be called once the benchmark is finished.
+   */
+  [[nodiscard]] Summary summarize() const;
+
+private:
+  CameraPath path_;
+  GLuint warmup_frames_;
+  GLuint measured_frames_;
+  GLuint frame_ {};
+  std::chrono::steady_clock::time_point last_frame_end_;
+  std::vector<double> frame_ms_;
+};
+#endif //TEMPLEGL_SRC_BENCHMARK_H_
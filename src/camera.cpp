@@ -54,6 +54,13 @@ void Camera::processMouseScroll(const float offset, const float delta_time) {
   state_.move_speed = glm::clamp(state_.move_speed, 0.1f, config_.max_move_speed);
 }
 
+void Camera::setPose(const glm::vec3& position, const float yaw, const float pitch) {
+  state_.position = position;
+  state_.yaw      = yaw;
+  state_.pitch    = glm::clamp(pitch, -HALF_PI + 0.01f, HALF_PI - 0.01f);
+  updateCameraVectors();
+}
+
 void Camera::updateCameraVectors() {
   const glm::vec3 new_front {std::cos(state_.yaw) * std::cos(state_.pitch),
                              std::sin(state_.pitch),
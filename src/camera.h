@@ -23,6 +23,8 @@ public:
   [[nodiscard]] glm::mat4 getViewMatrix() const { return state_.view_matrix; }
   [[nodiscard]] glm::mat4 getProjectionMatrix() const { return state_.projection_matrix; }
   [[nodiscard]] glm::vec3 getPosition() const { return state_.position; }
+  [[nodiscard]] float getYaw() const { return state_.yaw; }
+  [[nodiscard]] float getPitch() const { return state_.pitch; }
   void updateAspectRatio(const float aspect_ratio) { config_.aspect_ratio = aspect_ratio; }
   void updateViewMatrix() {
     state_.view_matrix = glm::lookAt(state_.position, state_.position + state_.front, state_.up);
@@ -61,6 +63,15 @@ public:
    */
   void processMouseScroll(float offset, float delta_time);
 
+  /**
+   * Places and orients the camera directly, for example along a scripted path. Pitch is clamped as in
+   * processMouseMovement(). The view matrix is not updated.
+   *
+   * @param yaw     In radians, 0 looks along the world space x-axis.
+   * @param pitch   In radians.
+   */
+  void setPose(const glm::vec3& position, float yaw, float pitch);
+
 private:
   struct Config {
     float fov;
@@ -0,0 +1,109 @@
+#include "camera_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * Cubic Hermite interpolation between p1 and p2, with Catmull-Rom tangents scaled to the (non-uniform) keyframe
+ * spacing. At the ends of the path p0 == p1 or p3 == p2, which reduces the tangent to a one-sided difference.
+ */
+template <typename T>
+static T interpolateCatmullRom(const T& p0, const T& p1, const T& p2, const T& p3,
+                               const float t0, const float t1, const float t2, const float t3,
+                               const float s) {
+  const float segment {t2 - t1};
+  const T m1 {(p2 - p0) * (segment / (t2 - t0))};
+  const T m2 {(p3 - p1) * (segment / (t3 - t1))};
+  const float s2 {s * s};
+  const float s3 {s2 * s};
+  return p1 * (2.0f * s3 - 3.0f * s2 + 1.0f)
+         + m1 * (s3 - 2.0f * s2 + s)
+         + p2 * (3.0f * s2 - 2.0f * s3)
+         + m2 * (s3 - s2);
+}
+
+CameraPath::CameraPath(std::vector<Keyframe> keyframes) : keyframes_ {std::move(keyframes)} {}
+
+CameraPath CameraPath::loadRecording(const std::string& path) {
+  std::ifstream file {path};
+  if (!file) {
+    throw std::runtime_error(std::format("ERROR (CameraPath::loadRecording): Failed to open '{}'.", path));
+  }
+  std::vector<Keyframe> keyframes;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line.front() == '#') continue;
+    std::istringstream values {line};
+    Keyframe keyframe;
+    values >> keyframe.time
+           >> keyframe.pose.position.x >> keyframe.pose.position.y >> keyframe.pose.position.z
+           >> keyframe.pose.yaw >> keyframe.pose.pitch;
+    if (!values) {
+      throw std::runtime_error(std::format("ERROR (CameraPath::loadRecording): Failed to parse '{}', line '{}'.",
+                                           path,
+                                           line));
+    }
+    // Frames recorded within the same clock tick would break the spline, so only the first of them is kept
+    if (keyframes.empty() || keyframe.time > keyframes.back().time) keyframes.push_back(keyframe);
+  }
+  if (keyframes.empty()) {
+    throw std::runtime_error(std::format("ERROR (CameraPath::loadRecording): '{}' holds no poses.", path));
+  }
+  return CameraPath(std::move(keyframes));
+}
+
+CameraPath::Pose CameraPath::getPose(const float time) const {
+  if (time <= keyframes_.front().time) return keyframes_.front().pose;
+  if (time >= keyframes_.back().time) return keyframes_.back().pose;
+
+  /// Find the keyframes around the given time, and the ones before and after them
+  const auto next {std::ranges::upper_bound(keyframes_, time, {}, &Keyframe::time)};
+  const auto i2 {static_cast<size_t>(next - keyframes_.begin())};
+  const size_t i1 {i2 - 1};
+  const size_t i0 {i1 > 0 ? i1 - 1 : i1};
+  const size_t i3 {i2 + 1 < keyframes_.size() ? i2 + 1 : i2};
+  const Keyframe& k0 {keyframes_[i0]};
+  const Keyframe& k1 {keyframes_[i1]};
+  const Keyframe& k2 {keyframes_[i2]};
+  const Keyframe& k3 {keyframes_[i3]};
+  const float s {(time - k1.time) / (k2.time - k1.time)};
+
+  const glm::vec3 position {interpolateCatmullRom(k0.pose.position, k1.pose.position,
+                                                  k2.pose.position, k3.pose.position,
+                                                  k0.time, k1.time, k2.time, k3.time, s)};
+  const glm::vec2 angles {interpolateCatmullRom(glm::vec2(k0.pose.yaw, k0.pose.pitch),
+                                                glm::vec2(k1.pose.yaw, k1.pose.pitch),
+                                                glm::vec2(k2.pose.yaw, k2.pose.pitch),
+                                                glm::vec2(k3.pose.yaw, k3.pose.pitch),
+                                                k0.time, k1.time, k2.time, k3.time, s)};
+  return {position, angles.x, angles.y};
+}
+
+GLuint CameraPath::getNumFrames() const {
+  const float duration {keyframes_.back().time - keyframes_.front().time};
+  return static_cast<GLuint>(std::ceil(duration / TIME_STEP)) + 1;
+}
+
+CameraRecorder::CameraRecorder(const std::string& path) : file_ {path} {
+  if (!file_) {
+    throw std::runtime_error(std::format("ERROR (CameraRecorder::CameraRecorder): Failed to open '{}' for writing.",
+                                         path));
+  }
+  file_ << "# TempleGL camera path: time x y z yaw pitch (seconds, world units, radians)\n";
+}
+
+void CameraRecorder::record(const float time, const CameraPath::Pose& pose) {
+  if (num_poses_ == 0) start_time_ = time;
+  file_ << std::format("{} {} {} {} {} {}\n",
+                       time - start_time_,
+                       pose.position.x,
+                       pose.position.y,
+                       pose.position.z,
+                       pose.yaw,
+                       pose.pitch);
+  ++num_poses_;
+}
@@ -0,0 +1,89 @@
+#ifndef TEMPLEGL_SRC_CAMERA_PATH_H_
+#define TEMPLEGL_SRC_CAMERA_PATH_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+/**
+ * A camera path through timed keyframes, interpolated with a Catmull-Rom spline, so that the camera passes through
+ * every keyframe with a continuous velocity. Paths are either declared in config.yaml, or recorded with CameraRecorder.
+ * <p>
+ * Paths are sampled at multiples of TIME_STEP, rather than at wall-clock times, so that replaying a path always
+ * produces the same sequence of views, regardless of how long each frame takes.
+ */
+class CameraPath {
+public:
+  struct Pose {
+    glm::vec3 position;
+    float yaw;   // radians
+    float pitch; // radians
+  };
+  struct Keyframe {
+    float time; // seconds
+    Pose pose;
+  };
+
+  /**
+   * @param keyframes   At least one, with strictly increasing times.
+   */
+  explicit CameraPath(std::vector<Keyframe> keyframes);
+
+  /**
+   * Reads a file written by CameraRecorder. Throws std::runtime_error if the file cannot be read, or holds no poses.
+   */
+  [[nodiscard]] static CameraPath loadRecording(const std::string& path);
+
+  /**
+   * @returns   The pose at the given time. Times before the first or after the last keyframe return that keyframe.
+   */
+  [[nodiscard]] Pose getPose(float time) const;
+
+  /**
+   * @returns   The time of the given frame, counting from the first keyframe.
+   */
+  [[nodiscard]] float getFrameTime(const GLuint frame) const {
+    return keyframes_.front().time + static_cast<float>(frame) * TIME_STEP;
+  }
+
+  /**
+   * @returns   The number of frames needed to reach the last keyframe, including the first and the last frame.
+   */
+  [[nodiscard]] GLuint getNumFrames() const;
+
+  static constexpr float TIME_STEP {1.0f / 60.0f}; // seconds
+
+private:
+  std::vector<Keyframe> keyframes_;
+};
+
+/**
+ * Writes the camera pose of every frame to a text file, one "time x y z yaw pitch" line per frame (seconds since the
+ * first recorded frame, world units and radians). Values are written with the fewest digits that read back exactly.
+ */
+class CameraRecorder {
+public:
+  /**
+   * Throws std::runtime_error if the file cannot be opened for writing.
+   */
+  explicit CameraRecorder(const std::string& path);
+
+  /**
+   * @param time    Seconds, on any clock. Recorded times are relative to the first call.
+   */
+  void record(float time, const CameraPath::Pose& pose);
+
+  /**
+   * @returns   The number of poses recorded.
+   */
+  [[nodiscard]] GLuint getNumPoses() const { return num_poses_; }
+
+private:
+  std::ofstream file_;
+  float start_time_ {};
+  GLuint num_poses_ {};
+};
+#endif //TEMPLEGL_SRC_CAMERA_PATH_H_
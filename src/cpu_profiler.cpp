@@ -0,0 +1,77 @@
+#include "cpu_profiler.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
+
+CpuProfiler::Zone::Zone(const char* name, const bool gl_debug_group)
+  : name_ {name}, start_ns_ {getTimestamp()}, gl_debug_group_ {gl_debug_group} {
+  if (gl_debug_group_) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name_);
+}
+
+CpuProfiler::Zone::~Zone() {
+  if (gl_debug_group_) glPopDebugGroup();
+  getThreadBuffer().events.push_back({name_, start_ns_, getTimestamp()});
+}
+
+void CpuProfiler::setThreadName(const char* name) {
+  getThreadBuffer().name = name;
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& path) {
+  std::ofstream file {path};
+  if (!file) {
+    std::cerr << std::format("WARNING (CpuProfiler::writeChromeTrace): Failed to open '{}' for writing.", path)
+              << std::endl;
+    return false;
+  }
+  const std::lock_guard lock {thread_buffers_mutex_};
+  size_t num_events {0};
+  file << R"({"displayTimeUnit":"ns","traceEvents":[)";
+  const char* separator {"\n"};
+  for (const auto& buffer : thread_buffers_) {
+    if (buffer->name) {
+      file << std::format(R"({}{{"name":"thread_name","ph":"M","pid":0,"tid":{},"args":{{"name":"{}"}}}})",
+                          separator,
+                          buffer->id,
+                          buffer->name);
+      separator = ",\n";
+    }
+    // Timestamps are in microseconds, with nanosecond precision
+    for (const Event& event : buffer->events) {
+      file << std::format(R"({}{{"name":"{}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                          separator,
+                          event.name,
+                          buffer->id,
+                          static_cast<double>(event.start_ns) / 1e3,
+                          static_cast<double>(event.end_ns - event.start_ns) / 1e3);
+      separator = ",\n";
+    }
+    num_events += buffer->events.size();
+  }
+  file << "\n]}\n";
+  std::cout << std::format("INFO (CpuProfiler::writeChromeTrace): Wrote {} zones of {} threads to '{}'.",
+                           num_events,
+                           thread_buffers_.size(),
+                           path)
+            << std::endl;
+  return static_cast<bool>(file);
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::getThreadBuffer() {
+  thread_local ThreadBuffer* buffer {nullptr};
+  if (!buffer) {
+    const std::lock_guard lock {thread_buffers_mutex_};
+    buffer = thread_buffers_.emplace_back(std::make_unique<ThreadBuffer>()).get();
+    buffer->id = static_cast<std::uint32_t>(thread_buffers_.size());
+  }
+  return *buffer;
+}
+
+std::int64_t CpuProfiler::getTimestamp() {
+  static const auto start {std::chrono::steady_clock::now()};
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,85 @@
+#ifndef TEMPLEGL_SRC_CPU_PROFILER_H_
+#define TEMPLEGL_SRC_CPU_PROFILER_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * Records scoped CPU zones with nanosecond timestamps, and exports them as Chrome trace_event JSON (which can be opened
+ * in chrome://tracing or https://ui.perfetto.dev).
+ * <p>
+ * Zones are placed with the macros below, which only expand to anything if TEMPLEGL_PROFILE_CPU is defined (see the
+ * CMake option of the same name). Each thread appends to its own buffer, so recording a zone takes no locks. Only the
+ * first zone of every thread briefly locks a mutex, to register the thread's buffer.
+ */
+class CpuProfiler {
+public:
+  /**
+   * Records the time between its construction and destruction. Zones on the same thread must be properly nested,
+   * which scoping them guarantees.
+   */
+  class Zone {
+  public:
+    /**
+     * @param name            Must have static storage duration, for example a string literal.
+     * @param gl_debug_group  If true, the zone is also pushed as an OpenGL debug group, so that it shows up in
+     *                        graphics debuggers. Requires a current OpenGL context.
+     */
+    Zone(const char* name, bool gl_debug_group);
+    ~Zone();
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+  private:
+    const char* name_;
+    std::int64_t start_ns_;
+    bool gl_debug_group_;
+  };
+
+  /**
+   * Names the calling thread in exported traces. The name must have static storage duration.
+   */
+  static void setThreadName(const char* name);
+
+  /**
+   * Writes every zone recorded so far, by all threads. No other thread may be recording zones meanwhile.
+   *
+   * @returns   Whether the file was written successfully.
+   */
+  static bool writeChromeTrace(const std::string& path);
+
+private:
+  struct Event {
+    const char* name;
+    std::int64_t start_ns;
+    std::int64_t end_ns;
+  };
+  struct ThreadBuffer {
+    std::vector<Event> events;
+    const char* name;
+    std::uint32_t id;
+  };
+
+  // Owns the buffers of all threads that ever recorded a zone, so that their zones outlive them
+  inline static std::mutex thread_buffers_mutex_;
+  inline static std::vector<std::unique_ptr<ThreadBuffer>> thread_buffers_;
+
+  [[nodiscard]] static ThreadBuffer& getThreadBuffer();
+  [[nodiscard]] static std::int64_t getTimestamp(); // nanoseconds since the first call
+};
+
+#ifdef TEMPLEGL_PROFILE_CPU
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) const CpuProfiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__) {name, false}
+#define PROFILE_GL_ZONE(name) const CpuProfiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__) {name, true}
+#define PROFILE_THREAD_NAME(name) CpuProfiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name) static_cast<void>(0)
+#define PROFILE_GL_ZONE(name) static_cast<void>(0)
+#define PROFILE_THREAD_NAME(name) static_cast<void>(0)
+#endif
+#endif //TEMPLEGL_SRC_CPU_PROFILER_H_
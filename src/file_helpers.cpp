@@ -0,0 +1,69 @@
+#include "file_helpers.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+help::MappedFile::MappedFile(const std::string& path) {
+  const HANDLE file {CreateFileA(path.c_str(),
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ,
+                                 nullptr,
+                                 OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                 nullptr)};
+  if (file == INVALID_HANDLE_VALUE) return;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) {
+      data_ = static_cast<const std::byte*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+      if (data_) size_ = static_cast<size_t>(size.QuadPart);
+    }
+  }
+  CloseHandle(file);
+}
+
+help::MappedFile::~MappedFile() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+}
+#else
+help::MappedFile::MappedFile(const std::string& path) {
+  const int file {open(path.c_str(), O_RDONLY)};
+  if (file < 0) return;
+  struct stat status {};
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    void* data {mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0)};
+    if (data != MAP_FAILED) {
+      data_ = static_cast<const std::byte*>(data);
+      size_  = static_cast<size_t>(status.st_size);
+      madvise(data, size_, MADV_SEQUENTIAL);
+    }
+  }
+  close(file);
+}
+
+help::MappedFile::~MappedFile() {
+  if (data_) munmap(const_cast<std::byte*>(data_), size_);
+}
+#endif
+
+help::FileStamp help::getFileStamp(const std::string& path) {
+  std::error_code error;
+  const auto size {std::filesystem::file_size(path, error)};
+  if (error) return {-1, -1};
+  const auto time {std::filesystem::last_write_time(path, error)};
+  if (error) return {-1, -1};
+  return {static_cast<std::int64_t>(size), static_cast<std::int64_t>(time.time_since_epoch().count())};
+}
@@ -0,0 +1,48 @@
+#ifndef TEMPLEGL_SRC_FILE_HELPERS_H_
+#define TEMPLEGL_SRC_FILE_HELPERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+/**
+ * Collects helper functions and types for reading and writing binary files.
+ */
+namespace help {
+  /**
+   * Maps a whole file into memory (read-only), and unmaps it when going out of scope. The pages are only read from disk
+   * when first accessed, so passing data() straight to OpenGL avoids any intermediate copy.
+   */
+  class MappedFile {
+  public:
+    /**
+     * Maps the file at the given path. If the file does not exist or cannot be mapped, data() will be empty.
+     */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] std::span<const std::byte> data() const { return {data_, size_}; }
+
+  private:
+    const std::byte* data_ {};
+    size_t size_ {};
+#ifdef _WIN32
+    void* mapping_ {};
+#endif
+  };
+
+  /**
+   * Identifies the current version of a file by its size and last modification time, or returns {-1, -1} if it does
+   * not exist.
+   */
+  struct FileStamp {
+    std::int64_t size;
+    std::int64_t modification_time;
+    bool operator==(const FileStamp&) const = default;
+  };
+  [[nodiscard]] FileStamp getFileStamp(const std::string& path);
+}
+#endif //TEMPLEGL_SRC_FILE_HELPERS_H_
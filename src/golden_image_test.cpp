@@ -0,0 +1,76 @@
+#include "golden_image_test.h"
+#include "stbi_helpers.h"
+#include "image_compare_helpers.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <utility>
+
+GoldenImageTest::GoldenImageTest(std::vector<View> views,
+                                 const GLuint frames_per_view,
+                                 std::string directory,
+                                 const Thresholds thresholds,
+                                 const bool allow_missing,
+                                 const bool update)
+  : views_ {std::move(views)},
+    frames_per_view_ {frames_per_view},
+    directory_ {std::move(directory)},
+    thresholds_ {thresholds},
+    allow_missing_ {allow_missing},
+    update_ {update} {
+  results_.reserve(views_.size());
+  if (update_) std::filesystem::create_directories(directory_);
+}
+
+bool GoldenImageTest::endFrame() {
+  const auto now {std::chrono::steady_clock::now()};
+  if (frame_ == 0) first_frame_end_ = now;
+  if (++frame_ < frames_per_view_) return false;
+  frame_ms_ = std::chrono::duration<double, std::milli>(now - first_frame_end_).count() / (frames_per_view_ - 1);
+  frame_    = 0;
+  return true;
+}
+
+void GoldenImageTest::checkImage(const std::vector<unsigned char>& pixels, const GLsizei width, const GLsizei height) {
+  const View& view {views_[results_.size()]};
+  Result& result {results_.emplace_back(Result {view.name, help::MAX_PSNR, 1.0, frame_ms_, {}, PASSED})};
+  const std::string golden_path {directory_ + view.name + ".png"};
+  if (update_) {
+    if (!help::writeImage(golden_path, width, height, pixels)) {
+      result.error  = std::format("Failed to write '{}'.", golden_path);
+      result.status = FAILED;
+    }
+    return;
+  }
+
+  if (!std::filesystem::exists(golden_path)) {
+    result.error  = std::format("No golden image '{}'. Run with --update-golden to create it.", golden_path);
+    result.status = allow_missing_ ? SKIPPED : FAILED;
+    return;
+  }
+  std::vector<unsigned char> golden_pixels;
+  if (std::string error {help::loadImage(golden_path, {}, width, height, golden_pixels)}; !error.empty()) {
+    result.error  = error;
+    result.status = FAILED;
+    return;
+  }
+  result.psnr   = help::computePsnr(pixels, golden_pixels);
+  result.ssim   = help::computeSsim(pixels, golden_pixels, width, height);
+  result.status = result.psnr >= thresholds_.min_psnr && result.ssim >= thresholds_.min_ssim ? PASSED : FAILED;
+  if (result.status == FAILED) help::writeImage(directory_ + view.name + ".actual.png", width, height, pixels);
+}
+
+GoldenImageTest::Status GoldenImageTest::getStatus() const {
+  if (!isFinished()) return FAILED;
+  return std::ranges::max(results_, {}, &Result::status).status;
+}
+
+const char* GoldenImageTest::getStatusName(const Status status) {
+  switch (status) {
+    case PASSED:  return "passed";
+    case SKIPPED: return "skipped";
+    case FAILED:  return "failed";
+  }
+  return "failed";
+}
@@ -0,0 +1,94 @@
+#ifndef TEMPLEGL_SRC_GOLDEN_IMAGE_TEST_H_
+#define TEMPLEGL_SRC_GOLDEN_IMAGE_TEST_H_
+
+#include "camera_path.h"
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+/**
+ * Drives a golden image test: renders a fixed number of frames at each of a list of camera poses, and compares the
+ * last frame of each against a stored PNG file (the golden image) by PSNR and SSIM. Alternatively, replaces the golden
+ * images with the current renders. The average frame time at each pose is recorded alongside, so that optimizations
+ * can show both their speed-up and that the output stayed within the thresholds.
+ */
+class GoldenImageTest {
+public:
+  struct View {
+    std::string name; // the golden image is <directory><name>.png
+    CameraPath::Pose pose;
+  };
+  struct Thresholds {
+    double min_psnr; // dB
+    double min_ssim;
+  };
+  enum Status {
+    PASSED,
+    SKIPPED, // the golden image does not exist yet, and missing golden images are allowed
+    FAILED   // ordered by severity, so the status of a whole test is that of its worst view
+  };
+  struct Result {
+    std::string name;
+    double psnr;
+    double ssim;
+    double frame_ms; // average over all frames at the pose but the first
+    std::string error; // empty unless the golden image is missing or could not be read or written
+    Status status;
+  };
+
+  /**
+   * @param frames_per_view At least two. Frames before the last let time-dependent state (shadow caches, SDSM bounds)
+   *                        settle, so that the compared frame does not depend on the previous pose.
+   * @param allow_missing   If true, views without a golden image are skipped instead of failed.
+   * @param update          If true, the golden images are written instead of compared against.
+   */
+  GoldenImageTest(std::vector<View> views,
+                  GLuint frames_per_view,
+                  std::string directory,
+                  Thresholds thresholds,
+                  bool allow_missing,
+                  bool update);
+
+  [[nodiscard]] const CameraPath::Pose& getPose() const { return views_[results_.size()].pose; }
+
+  /**
+   * Must be called at the same point of every frame.
+   *
+   * @returns   Whether the frame was the last one at its pose, in which case its image must be passed to checkImage().
+   */
+  bool endFrame();
+
+  /**
+   * Compares the image against the golden image of the current view (or replaces it), and moves to the next view. If
+   * they differ too much, the image is also written to <directory><name>.actual.png, for inspection. If there is no
+   * golden image, the view fails, or is skipped if missing golden images are allowed.
+   *
+   * @param pixels  width * height texels with 3 tightly packed channels each, starting with the top row.
+   */
+  void checkImage(const std::vector<unsigned char>& pixels, GLsizei width, GLsizei height);
+
+  [[nodiscard]] bool isFinished() const { return results_.size() == views_.size(); }
+  /**
+   * @returns   The worst status of any view, or FAILED if not every view was checked.
+   */
+  [[nodiscard]] Status getStatus() const;
+  [[nodiscard]] static const char* getStatusName(Status status);
+  [[nodiscard]] bool isUpdating() const { return update_; }
+  [[nodiscard]] const std::vector<Result>& getResults() const { return results_; }
+
+private:
+  std::vector<View> views_;
+  GLuint frames_per_view_;
+  std::string directory_;
+  Thresholds thresholds_;
+  bool allow_missing_;
+  bool update_;
+  GLuint frame_ {}; // at the current view
+  std::chrono::steady_clock::time_point first_frame_end_;
+  double frame_ms_ {};
+  std::vector<Result> results_; // one per view done so far
+};
+#endif //TEMPLEGL_SRC_GOLDEN_IMAGE_TEST_H_
@@ -0,0 +1,122 @@
+#include "gpu_profiler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <utility>
+
+GpuProfiler::GpuProfiler(std::vector<std::string> pass_names, const std::string& csv_path)
+  : pass_names_ {std::move(pass_names)},
+    pass_history_(pass_names_.size()),
+    num_queries_ {GLAD_GL_ARB_pipeline_statistics_query ? NUM_QUERIES : size_t {1}} {
+  if (num_queries_ == 1) {
+    std::cerr << "WARNING (GpuProfiler::GpuProfiler): ARB_pipeline_statistics_query is not supported. Only pass times "
+              << "will be measured." << std::endl;
+  }
+  pass_queries_.reserve(RING_SIZE * pass_names_.size());
+  for (size_t i = 0; i < RING_SIZE * pass_names_.size(); ++i) {
+    auto& entry {pass_queries_.emplace_back(std::make_unique<PassQueries>())};
+    for (size_t query = 0; query < num_queries_; ++query) {
+      glCreateQueries(QUERY_TARGETS[query], 1, &entry->queries[query].id);
+    }
+  }
+  for (PassHistory& history : pass_history_) { history.gpu_ms.reserve(HISTORY_SIZE); }
+
+  if (!csv_path.empty()) {
+    csv_.open(csv_path);
+    if (!csv_) {
+      std::cerr << std::format("WARNING (GpuProfiler::GpuProfiler): Failed to open '{}' for writing.", csv_path)
+                << std::endl;
+    } else {
+      csv_ << "frame,pass,gpu_ms,vertices_submitted,primitives_submitted,fragment_shader_invocations\n";
+    }
+  }
+}
+
+void GpuProfiler::beginFrame() {
+  ++frame_;
+  for (size_t pass = 0; pass < pass_names_.size(); ++pass) { collectResults(pass); }
+}
+
+void GpuProfiler::begin(const size_t pass) {
+  PassQueries& entry {getPassQueries(pass)};
+  for (size_t query = 0; query < num_queries_; ++query) {
+    glBeginQuery(QUERY_TARGETS[query], entry.queries[query].id);
+  }
+}
+
+void GpuProfiler::end(const size_t pass) {
+  PassQueries& entry {getPassQueries(pass)};
+  for (size_t query = 0; query < num_queries_; ++query) { glEndQuery(QUERY_TARGETS[query]); }
+  entry.frame   = frame_;
+  entry.pending = true;
+}
+
+void GpuProfiler::report() const {
+  std::string report {std::format("INFO (GpuProfiler::report): GPU time per pass over the last {} frames:",
+                                  HISTORY_SIZE)};
+  for (size_t pass = 0; pass < pass_names_.size(); ++pass) {
+    const PassHistory& history {pass_history_[pass]};
+    if (history.gpu_ms.empty()) continue;
+    std::vector sorted {history.gpu_ms};
+    std::ranges::sort(sorted);
+    double sum {0.0};
+    for (const double sample : sorted) { sum += sample; }
+    const size_t p99_index {(sorted.size() * 99 + 99) / 100 - 1};
+    report += std::format("\n  {:<16} min {:7.3f} ms, avg {:7.3f} ms, p99 {:7.3f} ms",
+                          pass_names_[pass],
+                          sorted.front(),
+                          sum / static_cast<double>(sorted.size()),
+                          sorted[p99_index]);
+    if (num_queries_ > 1) {
+      report += std::format(" | {} vertices, {} primitives, {} fragment invocations",
+                            history.latest_results[VERTICES_SUBMITTED],
+                            history.latest_results[PRIMITIVES_SUBMITTED],
+                            history.latest_results[FRAGMENT_SHADER_INVOCATIONS]);
+    }
+  }
+  std::cout << report << std::endl;
+}
+
+void GpuProfiler::collectResults(const size_t pass) {
+  PassQueries& entry {getPassQueries(pass)};
+  if (!entry.pending) return;
+  entry.pending = false;
+  GLuint available;
+  glGetQueryObjectuiv(entry.queries[TIME_ELAPSED].id, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    // Only possible if the GPU is more than RING_SIZE frames behind. Drop the sample rather than stall.
+    glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                         GL_DEBUG_TYPE_PERFORMANCE,
+                         0,
+                         GL_DEBUG_SEVERITY_LOW,
+                         -1,
+                         "(GpuProfiler::collectResults): Query results were not ready, dropping a sample.");
+    return;
+  }
+  PassHistory& history {pass_history_[pass]};
+  for (size_t query = 0; query < num_queries_; ++query) {
+    glGetQueryObjectui64v(entry.queries[query].id, GL_QUERY_RESULT, &history.latest_results[query]);
+  }
+  const double gpu_ms {static_cast<double>(history.latest_results[TIME_ELAPSED]) / 1e6};
+  if (history.gpu_ms.size() < HISTORY_SIZE) {
+    history.gpu_ms.push_back(gpu_ms);
+  } else {
+    history.gpu_ms[history.next_sample] = gpu_ms;
+  }
+  history.next_sample = (history.next_sample + 1) % HISTORY_SIZE;
+
+  if (csv_.is_open()) {
+    csv_ << std::format("{},{},{:.6f}", entry.frame, pass_names_[pass], gpu_ms);
+    for (size_t query = VERTICES_SUBMITTED; query < NUM_QUERIES; ++query) {
+      if (query < num_queries_) {
+        csv_ << ',' << history.latest_results[query];
+      } else {
+        csv_ << ',';
+      }
+    }
+    csv_ << '\n';
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef TEMPLEGL_SRC_GPU_PROFILER_H_
+#define TEMPLEGL_SRC_GPU_PROFILER_H_
+
+#include "opengl_wrappers.h"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <fstream>
+
+/**
+ * Measures the GPU time of a fixed set of render passes with GL_TIME_ELAPSED queries. If ARB_pipeline_statistics_query
+ * is supported, the vertices and primitives submitted and the fragment shader invocations of each pass are counted too.
+ * <p>
+ * Queries are kept in a ring of RING_SIZE frames, and the results of a frame are only read when its slot comes up
+ * again. The frames in flight limit (see Initializer) guarantees the GPU is done with that frame by then, so reading
+ * the results never stalls.
+ */
+class GpuProfiler {
+public:
+  /**
+   * @param pass_names  One name per pass, indexed by the pass argument of begin() and end().
+   * @param csv_path    If not empty, the results of every pass of every frame are written to this file.
+   */
+  GpuProfiler(std::vector<std::string> pass_names, const std::string& csv_path);
+
+  /**
+   * Must be called at the start of every profiled frame, before any begin() call. Collects the results of the frame
+   * that last used the current slot.
+   */
+  void beginFrame();
+
+  /**
+   * Passes may not be nested or overlap, since only one GL_TIME_ELAPSED query can be active at a time. Passes that
+   * are skipped in some frames are simply not measured in those frames.
+   */
+  void begin(size_t pass);
+  void end(size_t pass);
+
+  /**
+   * Prints the minimum, average and 99th percentile time of each pass over the last HISTORY_SIZE frames in which it
+   * ran, and its pipeline statistics for the most recent of those frames.
+   */
+  void report() const;
+
+  static constexpr size_t RING_SIZE {4}; // must exceed Initializer::MAX_FRAMES_IN_FLIGHT
+  static constexpr size_t HISTORY_SIZE {240};
+
+private:
+  enum QueryIndex { TIME_ELAPSED, VERTICES_SUBMITTED, PRIMITIVES_SUBMITTED, FRAGMENT_SHADER_INVOCATIONS, NUM_QUERIES };
+  static constexpr std::array<GLenum, NUM_QUERIES> QUERY_TARGETS {GL_TIME_ELAPSED,
+                                                                  GL_VERTICES_SUBMITTED_ARB,
+                                                                  GL_PRIMITIVES_SUBMITTED_ARB,
+                                                                  GL_FRAGMENT_SHADER_INVOCATIONS_ARB};
+  struct PassQueries {
+    std::array<wrap::Query, NUM_QUERIES> queries;
+    GLuint64 frame; // the frame in which the queries were last issued
+    bool pending;   // whether the queries were issued, and their results not yet read
+  };
+  struct PassHistory {
+    std::vector<double> gpu_ms; // ring of up to HISTORY_SIZE samples
+    size_t next_sample;
+    std::array<GLuint64, NUM_QUERIES> latest_results;
+  };
+
+  std::vector<std::string> pass_names_;
+  std::vector<std::unique_ptr<PassQueries>> pass_queries_; // RING_SIZE slots of one entry per pass
+  std::vector<PassHistory> pass_history_;
+  size_t num_queries_; // 1 without pipeline statistics
+  GLuint64 frame_ {};
+  std::ofstream csv_;
+
+  [[nodiscard]] PassQueries& getPassQueries(size_t pass) const {
+    return *pass_queries_[frame_ % RING_SIZE * pass_names_.size() + pass];
+  }
+  void collectResults(size_t pass);
+};
+#endif //TEMPLEGL_SRC_GPU_PROFILER_H_
@@ -0,0 +1,65 @@
+#include "image_compare_helpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+double help::computePsnr(const std::span<const unsigned char> a, const std::span<const unsigned char> b) {
+  double squared_error_sum {0.0};
+  for (size_t i = 0; i < a.size(); ++i) {
+    const double difference {static_cast<double>(a[i]) - static_cast<double>(b[i])};
+    squared_error_sum += difference * difference;
+  }
+  if (squared_error_sum == 0.0) return MAX_PSNR;
+  const double mean_squared_error {squared_error_sum / static_cast<double>(a.size())};
+  return std::min(10.0 * std::log10(255.0 * 255.0 / mean_squared_error), MAX_PSNR);
+}
+
+double help::computeSsim(const std::span<const unsigned char> a,
+                         const std::span<const unsigned char> b,
+                         const GLsizei width,
+                         const GLsizei height) {
+  /// Convert both images to luma (Rec. 601 weights)
+  const auto num_texels {static_cast<size_t>(width) * height};
+  std::vector<double> luma_a(num_texels);
+  std::vector<double> luma_b(num_texels);
+  for (size_t i = 0; i < num_texels; ++i) {
+    luma_a[i] = 0.299 * a[3 * i] + 0.587 * a[3 * i + 1] + 0.114 * a[3 * i + 2];
+    luma_b[i] = 0.299 * b[3 * i] + 0.587 * b[3 * i + 1] + 0.114 * b[3 * i + 2];
+  }
+
+  /// Average the SSIM of every window. The constants stabilize the division for flat windows.
+  constexpr double C1 {(0.01 * 255.0) * (0.01 * 255.0)};
+  constexpr double C2 {(0.03 * 255.0) * (0.03 * 255.0)};
+  constexpr GLsizei WINDOW_SIZE {8};
+  constexpr GLsizei WINDOW_STRIDE {4};
+  const GLsizei window_width {std::min(width, WINDOW_SIZE)};
+  const GLsizei window_height {std::min(height, WINDOW_SIZE)};
+  const auto window_texels {static_cast<double>(window_width * window_height)};
+  double ssim_sum {0.0};
+  size_t num_windows {0};
+  for (GLsizei y = 0; y + window_height <= height; y += WINDOW_STRIDE) {
+    for (GLsizei x = 0; x + window_width <= width; x += WINDOW_STRIDE) {
+      double sum_a {0.0}, sum_b {0.0}, sum_aa {0.0}, sum_bb {0.0}, sum_ab {0.0};
+      for (GLsizei v = y; v < y + window_height; ++v) {
+        for (GLsizei u = x; u < x + window_width; ++u) {
+          const size_t i {static_cast<size_t>(v) * width + u};
+          sum_a += luma_a[i];
+          sum_b += luma_b[i];
+          sum_aa += luma_a[i] * luma_a[i];
+          sum_bb += luma_b[i] * luma_b[i];
+          sum_ab += luma_a[i] * luma_b[i];
+        }
+      }
+      const double mean_a {sum_a / window_texels};
+      const double mean_b {sum_b / window_texels};
+      const double variance_a {sum_aa / window_texels - mean_a * mean_a};
+      const double variance_b {sum_bb / window_texels - mean_b * mean_b};
+      const double covariance {sum_ab / window_texels - mean_a * mean_b};
+      ssim_sum += (2.0 * mean_a * mean_b + C1) * (2.0 * covariance + C2)
+                  / ((mean_a * mean_a + mean_b * mean_b + C1) * (variance_a + variance_b + C2));
+      ++num_windows;
+    }
+  }
+  return ssim_sum / static_cast<double>(num_windows);
+}
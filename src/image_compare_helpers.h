@@ -0,0 +1,34 @@
+#ifndef TEMPLEGL_SRC_IMAGE_COMPARE_HELPERS_H_
+#define TEMPLEGL_SRC_IMAGE_COMPARE_HELPERS_H_
+
+#include <glad/glad.h>
+
+#include <span>
+
+/**
+ * Collects helper functions that measure how much two images of the same dimensions differ.
+ */
+namespace help {
+  constexpr double MAX_PSNR {100.0}; // reported for identical images, whose PSNR is infinite
+
+  /**
+   * @param a, b    Images with any number of 8-bit channels, of equal size.
+   *
+   * @returns   The peak signal-to-noise ratio over all channels, in dB, at most MAX_PSNR.
+   */
+  [[nodiscard]] double computePsnr(std::span<const unsigned char> a, std::span<const unsigned char> b);
+
+  /**
+   * Computes the mean structural similarity (SSIM) of the luma of two images, over 8x8 pixel windows placed every 4
+   * pixels (or a single window covering smaller images).
+   *
+   * @param a, b    RGB images of width * height texels with 3 tightly packed channels each.
+   *
+   * @returns   A value between -1 and 1, where 1 means identical.
+   */
+  [[nodiscard]] double computeSsim(std::span<const unsigned char> a,
+                                   std::span<const unsigned char> b,
+                                   GLsizei width,
+                                   GLsizei height);
+}
+#endif //TEMPLEGL_SRC_IMAGE_COMPARE_HELPERS_H_
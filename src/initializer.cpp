@@ -1,4 +1,5 @@
 #include "initializer.h"
+#include "cpu_profiler.h"
 
 #include <yaml-cpp/yaml.h>
 #include <yaml-cpp/exceptions.h>
@@ -7,18 +8,27 @@
 
 template <typename T>
 void Initializer<T>::run() {
+  PROFILE_THREAD_NAME("main");
   loadConfigYaml();
   init();
   renderSetup();
   while (!glfwWindowShouldClose(window_)) {
+    PROFILE_ZONE("frame");
+    beginFrame();
     processKeyboardInput();
     updateRenderState();
     render();
-    glfwSwapBuffers(window_);
+    endFrame();
     glfwPollEvents();
   }
+  for (const GLsync fence : frame_pacing_.fences) {
+    if (fence) glDeleteSync(fence);
+  }
   renderTerminate();
   glfwTerminate();
+#ifdef TEMPLEGL_PROFILE_CPU
+  CpuProfiler::writeChromeTrace("cpu_trace.json");
+#endif
 }
 
 template <typename T>
@@ -36,6 +46,13 @@ void Initializer<T>::loadConfigYaml() {
     config_.window_height        = config_yaml["window"]["height"].as<int>();
     config_.window_initial_x_pos = config_yaml["window"]["initial_x_pos"].as<int>();
     config_.window_initial_y_pos = config_yaml["window"]["initial_y_pos"].as<int>();
+    config_.frames_in_flight     = config_yaml["window"]["frames_in_flight"].as<GLuint>();
+    if (config_.frames_in_flight < 1 || config_.frames_in_flight > MAX_FRAMES_IN_FLIGHT) {
+      std::cerr << "WARNING (Initializer::loadConfigYaml): invalid setting in config.yaml, "
+                << "window.frames_in_flight must be between 1 and " << MAX_FRAMES_IN_FLIGHT << ". Defaulting to 2."
+                << std::endl;
+      config_.frames_in_flight = 2;
+    }
 
     config_.debug_enabled = config_yaml["debug"]["enabled"].as<bool>();
     if (const auto debug_level_str {config_yaml["debug"]["level"].as<std::string>()};
@@ -60,13 +77,17 @@ void Initializer<T>::loadConfigYaml() {
 
 template <typename T>
 void Initializer<T>::init() {
-  /// Initialize GLFW
+  PROFILE_ZONE("Initializer::init");
+  /// Initialize GLFW. Headless contexts use the null platform, which needs no display, and create the context through
+  /// EGL (surfaceless, without a default framebuffer) or OSMesa (rendering on the CPU).
   glfwSetErrorCallback(glfwErrorCallback);
+  if (config_.headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
   if (!glfwInit()) { throw std::runtime_error("ERROR (Initializer::init): failed to initialize GLFW."); }
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   if (config_.debug_enabled) { glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE); }
+  if (config_.headless) { glfwWindowHint(GLFW_CONTEXT_CREATION_API, config_.headless_context_api); }
 
   /// Create GLFW window
   window_ = glfwCreateWindow(config_.window_width,
@@ -98,10 +119,31 @@ void Initializer<T>::init() {
   }
 
   /// Configure OpenGL debug output
+  configureDebugOutput();
+  if (config_.headless) {
+    std::cout << "INFO (Initializer::init): Created a headless OpenGL context on "
+              << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << "." << std::endl;
+  }
+
+  /// Create frame timing queries
+  for (wrap::Query& query : frame_pacing_.timestamps) {
+    glCreateQueries(GL_TIMESTAMP, 1, &query.id);
+  }
+
+  glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                       GL_DEBUG_TYPE_OTHER,
+                       0,
+                       GL_DEBUG_SEVERITY_NOTIFICATION,
+                       -1,
+                       "(Initializer::init): Completed successfully.");
+}
+
+template <typename T>
+void Initializer<T>::configureDebugOutput() const {
   int flags;
   glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
   if (flags & GL_CONTEXT_FLAG_DEBUG_BIT) { // Check if GLFW created debug context (expected if debug_enabled == true)
-    std::cout << "INFO (Initializer::init): OpenGL debug output enabled." << std::endl;
+    std::cout << "INFO (Initializer::configureDebugOutput): OpenGL debug output enabled." << std::endl;
     glEnable(GL_DEBUG_OUTPUT);
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     glDebugMessageCallback(debugMessageCallback, nullptr);
@@ -116,13 +158,46 @@ void Initializer<T>::init() {
       glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_MEDIUM, 0, nullptr, GL_FALSE);
     }
   }
+}
 
-  glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
-                       GL_DEBUG_TYPE_OTHER,
-                       0,
-                       GL_DEBUG_SEVERITY_NOTIFICATION,
-                       -1,
-                       "(Initializer::init): Completed successfully.");
+template <typename T>
+void Initializer<T>::beginFrame() {
+  PROFILE_ZONE("Initializer::beginFrame");
+  FramePacing& pacing {frame_pacing_};
+  const GLuint slot {pacing.frame % config_.frames_in_flight};
+  const auto wait_start {std::chrono::steady_clock::now()};
+  GLsync& fence {pacing.fences[slot]};
+  if (fence) {
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(fence);
+    fence = nullptr;
+    // The frame that last used this slot is complete, so its timestamps can be read without stalling
+    GLuint64 start_ns;
+    GLuint64 end_ns;
+    glGetQueryObjectui64v(pacing.timestamps[2 * slot].id, GL_QUERY_RESULT, &start_ns);
+    glGetQueryObjectui64v(pacing.timestamps[2 * slot + 1].id, GL_QUERY_RESULT, &end_ns);
+    frame_timings_.gpu_ms += static_cast<double>(end_ns - start_ns) / 1e6;
+    ++frame_timings_.gpu_frames;
+  }
+  pacing.cpu_start = std::chrono::steady_clock::now();
+  frame_timings_.wait_ms += std::chrono::duration<double, std::milli>(pacing.cpu_start - wait_start).count();
+  glQueryCounter(pacing.timestamps[2 * slot].id, GL_TIMESTAMP);
+}
+
+template <typename T>
+void Initializer<T>::endFrame() {
+  PROFILE_ZONE("Initializer::endFrame");
+  FramePacing& pacing {frame_pacing_};
+  const GLuint slot {pacing.frame % config_.frames_in_flight};
+  glQueryCounter(pacing.timestamps[2 * slot + 1].id, GL_TIMESTAMP);
+  const auto swap_start {std::chrono::steady_clock::now()};
+  frame_timings_.cpu_ms += std::chrono::duration<double, std::milli>(swap_start - pacing.cpu_start).count();
+  ++frame_timings_.cpu_frames;
+  if (!config_.headless) glfwSwapBuffers(window_); // headless contexts have nothing to present
+  frame_timings_.wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                      - swap_start).count();
+  pacing.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ++pacing.frame;
 }
 
 template <typename T>
@@ -3,8 +3,11 @@
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
+#include "opengl_wrappers.h"
 
 #include <string>
+#include <array>
+#include <chrono>
 
 enum DebugLevel { ALL, LOW, MEDIUM, HIGH };
 struct MinimalInitializerConfig {
@@ -15,6 +18,9 @@ struct MinimalInitializerConfig {
   int window_initial_y_pos;
   bool debug_enabled;
   DebugLevel debug_level;
+  GLuint frames_in_flight; // between 1 and MAX_FRAMES_IN_FLIGHT
+  bool headless;            // create the context without a display (see init()), and never swap buffers
+  int headless_context_api; // GLFW_EGL_CONTEXT_API or GLFW_OSMESA_CONTEXT_API
 };
 
 /**
@@ -30,8 +36,22 @@ public:
   virtual void run() final;
 
 protected:
+  /**
+   * Sums of the timings of all frames measured since the last resetFrameTimings() call. GPU timings are read back once
+   * a frame's fence has been reached, so they trail the CPU timings by up to frames_in_flight frames.
+   */
+  struct FrameTimings {
+    double cpu_ms;  // from the start of input processing until buffers are swapped
+    double wait_ms; // waiting for the oldest frame in flight to complete, plus the time spent in glfwSwapBuffers()
+    double gpu_ms;  // between timestamps written before the first and after the last command of the frame
+    GLuint cpu_frames;
+    GLuint gpu_frames;
+  };
+  static constexpr GLuint MAX_FRAMES_IN_FLIGHT {3};
+
   CONFIG_TYPE config_ {};
   GLFWwindow* window_ {}; // raw pointer, as destruction is handled by glfwTerminate()
+  FrameTimings frame_timings_ {};
 
   /// Program stages
   virtual void loadConfigYaml(); // should initialize all fields in CONFIG_TYPE
@@ -42,6 +62,12 @@ protected:
   virtual void render() {}
   virtual void renderTerminate() {}
 
+  /// Context setup
+  void configureDebugOutput() const; // applies debug_level to the current context, if it is a debug context
+
+  /// Frame pacing
+  void resetFrameTimings() { frame_timings_ = {}; }
+
   /// Callbacks
   virtual void framebufferSizeCallback(int width, int height); // default updates config_ and calls glViewport()
   virtual void cursorPosCallback(float x_pos, float y_pos) {}
@@ -54,5 +80,21 @@ protected:
                                             GLsizei length,
                                             const char* message,
                                             const void* user_param);
+
+private:
+  /**
+   * The CPU may run up to frames_in_flight frames ahead of the GPU. Each frame is fenced after its buffers are swapped,
+   * and the next frame that reuses its slot waits for that fence first.
+   */
+  struct FramePacing {
+    std::array<GLsync, MAX_FRAMES_IN_FLIGHT> fences;
+    std::array<wrap::Query, 2 * MAX_FRAMES_IN_FLIGHT> timestamps; // start and end of each frame in flight
+    std::chrono::steady_clock::time_point cpu_start;
+    GLuint frame;
+  };
+  FramePacing frame_pacing_ {};
+
+  void beginFrame(); // waits for a free slot, and starts timing the frame
+  void endFrame();   // swaps buffers, and fences the frame
 };
 #endif //TEMPLEGL_SRC_INITIALIZER_H_
@@ -0,0 +1,26 @@
+#include "json_helpers.h"
+
+#include <format>
+
+std::string help::escapeJsonString(const std::string_view text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    switch (c) {
+      case '"':  escaped += "\\\""; break;
+      case '\\': escaped += "\\\\"; break;
+      case '\b': escaped += "\\b"; break;
+      case '\f': escaped += "\\f"; break;
+      case '\n': escaped += "\\n"; break;
+      case '\r': escaped += "\\r"; break;
+      case '\t': escaped += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          escaped += std::format("\\u{:04x}", static_cast<unsigned int>(c));
+        } else {
+          escaped += c;
+        }
+    }
+  }
+  return escaped;
+}
@@ -0,0 +1,17 @@
+#ifndef TEMPLEGL_SRC_JSON_HELPERS_H_
+#define TEMPLEGL_SRC_JSON_HELPERS_H_
+
+#include <string>
+#include <string_view>
+
+/**
+ * Collects helper functions for writing the machine-readable JSON reports.
+ */
+namespace help {
+  /**
+   * Escapes quotes, backslashes and control characters, so that the result can be placed between quotes in a JSON
+   * document. Other bytes (including UTF-8 sequences) are copied unchanged.
+   */
+  [[nodiscard]] std::string escapeJsonString(std::string_view text);
+}
+#endif //TEMPLEGL_SRC_JSON_HELPERS_H_
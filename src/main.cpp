@@ -1,12 +1,38 @@
 #include "renderer.h"
 
 #include <iostream>
+#include <string>
+#include <string_view>
 
-int main() {
-  Renderer renderer {};
+// Returned by a golden image test in which no view failed, but some were skipped for lack of a golden image (only with
+// golden.allow_missing). Matches SKIP_RETURN_CODE of the CTest test.
+constexpr int GOLDEN_SKIPPED_EXIT_CODE {77};
+
+int main(const int argc, char** argv) {
+  Renderer::RunMode run_mode {Renderer::INTERACTIVE};
+  std::string camera_path;
+  for (int i = 1; i < argc; ++i) {
+    if (const std::string_view arg {argv[i]}; arg == "--benchmark") {
+      run_mode = Renderer::BENCHMARK;
+    } else if (arg == "--golden") {
+      run_mode = Renderer::GOLDEN_TEST;
+    } else if (arg == "--update-golden") {
+      run_mode = Renderer::GOLDEN_UPDATE;
+    } else if ((arg == "--record" || arg == "--replay") && i + 1 < argc) {
+      run_mode    = arg == "--record" ? Renderer::RECORD : Renderer::REPLAY;
+      camera_path = argv[++i];
+    } else {
+      std::cerr << "Usage: TempleGL [--record <file> | --replay <path name or file> | --benchmark | --golden | "
+                << "--update-golden]" << std::endl;
+      return -1;
+    }
+  }
+  Renderer renderer {run_mode, camera_path};
   try { renderer.run(); } catch (std::runtime_error& e) {
     std::cerr << std::endl << "FATAL ERROR: " << typeid(e).name() << std::endl << e.what() << std::endl;
     glfwTerminate();
     return -1;
   }
+  if (renderer.hasFailed()) return 1;
+  return renderer.hasSkipped() ? GOLDEN_SKIPPED_EXIT_CODE : 0;
 }
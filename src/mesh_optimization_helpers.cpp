@@ -0,0 +1,266 @@
+#include "mesh_optimization_helpers.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <unordered_map>
+
+namespace help {
+  void optimizeVertexCache(std::vector<GLuint>& indices, const GLuint cache_size) {
+    const size_t num_triangles {indices.size() / 3};
+    if (num_triangles < 2) return;
+
+    /// Work on compact local vertex ids, so that the cost does not depend on the range of the input indices
+    std::vector<GLuint> unique_indices {indices};
+    std::ranges::sort(unique_indices);
+    unique_indices.erase(std::ranges::unique(unique_indices).begin(), unique_indices.end());
+    const size_t num_vertices {unique_indices.size()};
+    std::vector<GLuint> local_indices(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+      local_indices[i] = static_cast<GLuint>(std::ranges::lower_bound(unique_indices, indices[i])
+                                             - unique_indices.begin());
+    }
+
+    /// Vertex-triangle adjacency, in compressed row form
+    std::vector<GLuint> live_triangles(num_vertices, 0);
+    for (const GLuint vertex : local_indices) { ++live_triangles[vertex]; }
+    std::vector<size_t> adjacency_offsets(num_vertices + 1, 0);
+    for (size_t v = 0; v < num_vertices; ++v) { adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v]; }
+    std::vector<GLuint> adjacency(local_indices.size());
+    std::vector<size_t> fill {adjacency_offsets.begin(), adjacency_offsets.end() - 1};
+    for (size_t i = 0; i < local_indices.size(); ++i) {
+      adjacency[fill[local_indices[i]]++] = static_cast<GLuint>(i / 3);
+    }
+
+    /// Tipsify: repeatedly fan out from a vertex, preferring vertices that will still be cached when their remaining
+    /// triangles are emitted
+    std::vector<size_t> cache_time(num_vertices, 0);
+    std::vector<bool> emitted(num_triangles, false);
+    std::vector<GLuint> dead_end_stack;
+    std::vector<GLuint> candidates;
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    size_t time {cache_size + 1};
+    size_t cursor {1};
+    GLint fanning_vertex {0};
+    while (fanning_vertex >= 0) {
+      candidates.clear();
+      const auto vertex {static_cast<size_t>(fanning_vertex)};
+      for (size_t a = adjacency_offsets[vertex]; a < adjacency_offsets[vertex + 1]; ++a) {
+        const GLuint triangle {adjacency[a]};
+        if (emitted[triangle]) continue;
+        emitted[triangle] = true;
+        for (size_t k = 0; k < 3; ++k) {
+          const GLuint v {local_indices[triangle * 3 + k]};
+          result.push_back(unique_indices[v]);
+          dead_end_stack.push_back(v);
+          candidates.push_back(v);
+          --live_triangles[v];
+          if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+        }
+      }
+
+      /// Choose the next fanning vertex among the candidates, or fall back to a dead end or the next unused vertex
+      fanning_vertex = -1;
+      size_t best_priority {0};
+      for (const GLuint v : candidates) {
+        if (live_triangles[v] == 0) continue;
+        size_t priority {1};
+        if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size) priority += time - cache_time[v];
+        if (priority > best_priority) {
+          best_priority  = priority;
+          fanning_vertex = static_cast<GLint>(v);
+        }
+      }
+      while (fanning_vertex < 0 && !dead_end_stack.empty()) {
+        const GLuint v {dead_end_stack.back()};
+        dead_end_stack.pop_back();
+        if (live_triangles[v] > 0) fanning_vertex = static_cast<GLint>(v);
+      }
+      while (fanning_vertex < 0 && cursor < num_vertices) {
+        if (live_triangles[cursor] > 0) fanning_vertex = static_cast<GLint>(cursor);
+        ++cursor;
+      }
+    }
+    indices = std::move(result);
+  }
+
+  std::vector<GLuint> getVertexFetchRemap(const std::span<const GLuint> indices, const size_t num_vertices) {
+    constexpr GLuint unassigned {~0u};
+    std::vector<GLuint> remap(num_vertices, unassigned);
+    GLuint next {0};
+    for (const GLuint index : indices) {
+      if (remap[index] == unassigned) remap[index] = next++;
+    }
+    for (GLuint& position : remap) {
+      if (position == unassigned) position = next++;
+    }
+    return remap;
+  }
+
+  size_t countVertexCacheMisses(const std::span<const GLuint> indices, const GLuint cache_size) {
+    std::deque<GLuint> cache;
+    size_t misses {0};
+    for (const GLuint index : indices) {
+      if (std::ranges::find(cache, index) != cache.end()) continue;
+      ++misses;
+      cache.push_back(index);
+      if (cache.size() > cache_size) cache.pop_front();
+    }
+    return misses;
+  }
+
+  namespace {
+    /**
+     * Symmetric 4x4 matrix, storing the sum of squared distances to a set of planes.
+     */
+    struct Quadric {
+      std::array<double, 10> m {};
+
+      void addPlane(const glm::vec3& normal, const double distance) {
+        const double a {normal.x}, b {normal.y}, c {normal.z}, d {distance};
+        m[0] += a * a; m[1] += a * b; m[2] += a * c; m[3] += a * d;
+        m[4] += b * b; m[5] += b * c; m[6] += b * d;
+        m[7] += c * c; m[8] += c * d;
+        m[9] += d * d;
+      }
+      void add(const Quadric& other) {
+        for (size_t i = 0; i < m.size(); ++i) { m[i] += other.m[i]; }
+      }
+      [[nodiscard]] double evaluate(const glm::vec3& v) const {
+        const double x {v.x}, y {v.y}, z {v.z};
+        return x * x * m[0] + 2.0 * x * y * m[1] + 2.0 * x * z * m[2] + 2.0 * x * m[3]
+               + y * y * m[4] + 2.0 * y * z * m[5] + 2.0 * y * m[6]
+               + z * z * m[7] + 2.0 * z * m[8]
+               + m[9];
+      }
+    };
+
+    struct Collapse {
+      GLuint from;
+      GLuint to;
+      double cost;
+    };
+
+    [[nodiscard]] glm::vec3 getNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+      return glm::cross(b - a, c - a);
+    }
+  }
+
+  std::vector<GLuint> simplifyMesh(const std::span<const GLuint> indices,
+                                   const std::span<const glm::vec3> positions,
+                                   const size_t target_index_count,
+                                   float& error) {
+    std::vector<GLuint> result {indices.begin(), indices.end()};
+    double max_cost {0.0};
+
+    /// Quadrics hold the planes of every triangle around a vertex. Vertices on open edges are locked.
+    std::unordered_map<GLuint, Quadric> quadrics;
+    std::unordered_map<std::uint64_t, GLuint> edge_use_counts;
+    const auto getEdgeKey {[](const GLuint a, const GLuint b) {
+      return static_cast<std::uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+    }};
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+      const glm::vec3 normal {getNormal(positions[result[i]], positions[result[i + 1]], positions[result[i + 2]])};
+      const float length {glm::length(normal)};
+      if (length > 0.0f) {
+        const glm::vec3 n {normal / length};
+        const double distance {-glm::dot(n, positions[result[i]])};
+        for (size_t k = 0; k < 3; ++k) { quadrics[result[i + k]].addPlane(n, distance); }
+      }
+      for (size_t k = 0; k < 3; ++k) { ++edge_use_counts[getEdgeKey(result[i + k], result[i + (k + 1) % 3])]; }
+    }
+    std::unordered_map<GLuint, bool> locked;
+    for (const auto& [key, count] : edge_use_counts) {
+      if (count != 1) continue;
+      locked[static_cast<GLuint>(key >> 32)]          = true;
+      locked[static_cast<GLuint>(key & 0xFFFFFFFFu)] = true;
+    }
+
+    /// Each pass collapses cheap edges, touching every vertex at most once, then rebuilds the triangle list
+    while (result.size() > target_index_count) {
+      std::unordered_map<GLuint, std::vector<size_t>> vertex_triangles;
+      std::vector<Collapse> collapses;
+      for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        for (size_t k = 0; k < 3; ++k) {
+          vertex_triangles[result[i + k]].push_back(i);
+          const GLuint a {result[i + k]};
+          const GLuint b {result[i + (k + 1) % 3]};
+          if (a > b) continue; // every interior edge is seen twice, once in each direction
+          Quadric sum {quadrics[a]};
+          sum.add(quadrics[b]);
+          if (!locked[a]) collapses.push_back({a, b, sum.evaluate(positions[b])});
+          if (!locked[b]) collapses.push_back({b, a, sum.evaluate(positions[a])});
+        }
+      }
+      std::ranges::sort(collapses, {}, &Collapse::cost);
+
+      // Only the cheapest quarter is considered at first, so that expensive collapses do not fill in for cheap ones
+      // that merely conflict with each other this pass. If none of those can be applied, all of them are considered.
+      std::unordered_map<GLuint, GLuint> remap;
+      for (const double pass_cost_limit : {collapses.empty() ? 0.0 : collapses[collapses.size() / 4].cost,
+                                           std::numeric_limits<double>::infinity()}) {
+        if (!remap.empty()) break;
+        std::unordered_map<GLuint, bool> touched;
+        size_t removed_indices {0};
+        for (const Collapse& collapse : collapses) {
+          if (result.size() - removed_indices <= target_index_count || collapse.cost > pass_cost_limit) break;
+          if (touched[collapse.from] || touched[collapse.to]) continue;
+
+          /// Reject the collapse if it would flip a remaining triangle around the moved vertex
+          bool flips {false};
+          size_t collapsed_triangles {0};
+          for (const size_t t : vertex_triangles[collapse.from]) {
+            std::array<glm::vec3, 3> corners {};
+            bool contains_target {false};
+            for (size_t k = 0; k < 3; ++k) {
+              contains_target = contains_target || result[t + k] == collapse.to;
+              corners[k]      = positions[result[t + k]];
+            }
+            if (contains_target) {
+              ++collapsed_triangles;
+              continue;
+            }
+            const glm::vec3 old_normal {getNormal(corners[0], corners[1], corners[2])};
+            for (size_t k = 0; k < 3; ++k) {
+              if (result[t + k] == collapse.from) corners[k] = positions[collapse.to];
+            }
+            if (glm::dot(old_normal, getNormal(corners[0], corners[1], corners[2])) <= 0.0f) {
+              flips = true;
+              break;
+            }
+          }
+          if (flips) continue;
+
+          remap[collapse.from] = collapse.to;
+          quadrics[collapse.to].add(quadrics[collapse.from]);
+          max_cost = std::max(max_cost, collapse.cost);
+          removed_indices += collapsed_triangles * 3;
+          for (const size_t t : vertex_triangles[collapse.from]) {
+            for (size_t k = 0; k < 3; ++k) { touched[result[t + k]] = true; }
+          }
+        }
+      }
+      if (remap.empty()) break;
+
+      /// Apply the collapses and drop the triangles that became degenerate
+      std::vector<GLuint> next;
+      next.reserve(result.size());
+      for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        std::array<GLuint, 3> triangle {};
+        for (size_t k = 0; k < 3; ++k) {
+          const auto it {remap.find(result[i + k])};
+          triangle[k] = it == remap.end() ? result[i + k] : it->second;
+        }
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) continue;
+        next.insert(next.end(), triangle.begin(), triangle.end());
+      }
+      result = std::move(next);
+    }
+    error = static_cast<float>(std::sqrt(std::max(max_cost, 0.0)));
+    return result;
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef TEMPLEGL_SRC_MESH_OPTIMIZATION_HELPERS_H_
+#define TEMPLEGL_SRC_MESH_OPTIMIZATION_HELPERS_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <span>
+#include <vector>
+
+/**
+ * Collects helper functions that reorder triangle lists for more efficient vertex processing on the GPU.
+ */
+namespace help {
+  /**
+   * Reorders the triangles of an indexed triangle list so that vertices are reused while they are still in the
+   * post-transform cache, using the Tipsify algorithm (Sander, Nehab and Barczak, 2007). The set of triangles, and the
+   * winding of each of them, are not changed.
+   *
+   * @param indices     Three indices per triangle. May reference any vertex range.
+   * @param cache_size  The number of vertices assumed to fit in the post-transform cache.
+   */
+  void optimizeVertexCache(std::vector<GLuint>& indices, GLuint cache_size);
+
+  /**
+   * Computes a vertex order in which vertices appear in the order they are first referenced, so that vertex fetches
+   * become (mostly) sequential. Unreferenced vertices are moved to the end.
+   *
+   * @param indices       Three indices per triangle, referencing vertices in [0, num_vertices).
+   * @param num_vertices  The number of vertices.
+   *
+   * @returns The new position of every vertex.
+   */
+  [[nodiscard]] std::vector<GLuint> getVertexFetchRemap(std::span<const GLuint> indices, size_t num_vertices);
+
+  /**
+   * Counts the post-transform cache misses of an indexed triangle list, assuming a FIFO cache.
+   *
+   * @param indices     Three indices per triangle.
+   * @param cache_size  The number of vertices assumed to fit in the cache.
+   */
+  [[nodiscard]] size_t countVertexCacheMisses(std::span<const GLuint> indices, GLuint cache_size);
+
+  /**
+   * Simplifies an indexed triangle list by collapsing edges in order of their quadric error (Garland and Heckbert,
+   * 1997). Vertices are only ever collapsed onto other existing vertices, so the result can share the vertex buffer of
+   * the input. Vertices on open edges (edges used by a single triangle) are never moved, which keeps the borders
+   * between separately simplified parts, and texture seams, watertight.
+   *
+   * @param indices             Three indices per triangle, referencing positions.
+   * @param positions           Vertex positions.
+   * @param target_index_count  Simplification stops once the result has at most this many indices, or when no more
+   *                            edges can be collapsed.
+   * @param error               Receives the largest distance (in the units of positions) between a collapsed vertex and
+   *                            the planes of the triangles it was merged from.
+   *
+   * @returns The simplified index list.
+   */
+  [[nodiscard]] std::vector<GLuint> simplifyMesh(std::span<const GLuint> indices,
+                                                 std::span<const glm::vec3> positions,
+                                                 size_t target_index_count,
+                                                 float& error);
+}
+#endif //TEMPLEGL_SRC_MESH_OPTIMIZATION_HELPERS_H_
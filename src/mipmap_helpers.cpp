@@ -0,0 +1,79 @@
+#include "mipmap_helpers.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+static constexpr float GAMMA {2.2f};
+
+static glm::vec3 decodeTexel(const unsigned char* texel, const help::MipFilter filter) {
+  const glm::vec3 value {texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f};
+  switch (filter) {
+    case help::MIP_FILTER_COLOR:  return glm::pow(value, glm::vec3(GAMMA));
+    case help::MIP_FILTER_LINEAR: return value;
+    case help::MIP_FILTER_NORMAL: return value * 2.0f - 1.0f;
+  }
+  return value;
+}
+
+static void encodeTexel(const glm::vec3& sum, const help::MipFilter filter, unsigned char* texel) {
+  glm::vec3 value {sum / 4.0f};
+  switch (filter) {
+    case help::MIP_FILTER_COLOR:
+      value = glm::pow(value, glm::vec3(1.0f / GAMMA));
+      break;
+    case help::MIP_FILTER_LINEAR:
+      break;
+    case help::MIP_FILTER_NORMAL:
+      // Opposing normals may cancel out, in which case the surface is treated as facing straight out
+      value = glm::length(sum) > 1e-6f ? glm::normalize(sum) : glm::vec3(0.0f, 0.0f, 1.0f);
+      value = value * 0.5f + 0.5f;
+      break;
+  }
+  for (int i = 0; i < 3; ++i) {
+    texel[i] = static_cast<unsigned char>(std::lround(std::clamp(value[i], 0.0f, 1.0f) * 255.0f));
+  }
+}
+
+GLsizei help::getNumMipLevels(const GLsizei width, const GLsizei height) {
+  return static_cast<GLsizei>(std::bit_width(static_cast<unsigned>(std::max(width, height))));
+}
+
+std::vector<std::vector<unsigned char>> help::generateMipLevels(const unsigned char* rgb,
+                                                                const GLsizei width,
+                                                                const GLsizei height,
+                                                                const GLsizei num_channels,
+                                                                const GLsizei num_levels,
+                                                                const MipFilter filter) {
+  const auto stride {static_cast<size_t>(num_channels)};
+  std::vector<std::vector<unsigned char>> levels;
+  levels.emplace_back(rgb, rgb + static_cast<size_t>(width) * height * stride);
+  for (GLsizei level = 1; level < num_levels; ++level) {
+    const GLsizei source_width {std::max(width >> (level - 1), 1)};
+    const GLsizei source_height {std::max(height >> (level - 1), 1)};
+    const GLsizei level_width {std::max(width >> level, 1)};
+    const GLsizei level_height {std::max(height >> level, 1)};
+    const std::vector<unsigned char>& source {levels.back()};
+    std::vector<unsigned char> destination(static_cast<size_t>(level_width) * level_height * stride);
+    for (GLsizei y = 0; y < level_height; ++y) {
+      for (GLsizei x = 0; x < level_width; ++x) {
+        glm::vec3 sum {0.0f};
+        unsigned alpha_sum {0};
+        for (GLsizei i = 0; i < 4; ++i) {
+          const GLsizei source_x {std::min(2 * x + i % 2, source_width - 1)};
+          const GLsizei source_y {std::min(2 * y + i / 2, source_height - 1)};
+          const unsigned char* texel {&source[(static_cast<size_t>(source_y) * source_width + source_x) * stride]};
+          sum += decodeTexel(texel, filter);
+          if (num_channels == 4) alpha_sum += texel[3];
+        }
+        unsigned char* texel {&destination[(static_cast<size_t>(y) * level_width + x) * stride]};
+        encodeTexel(sum, filter, texel);
+        if (num_channels == 4) texel[3] = static_cast<unsigned char>((alpha_sum + 2) / 4);
+      }
+    }
+    levels.push_back(std::move(destination));
+  }
+  return levels;
+}
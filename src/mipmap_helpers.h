@@ -0,0 +1,43 @@
+#ifndef TEMPLEGL_SRC_MIPMAP_HELPERS_H_
+#define TEMPLEGL_SRC_MIPMAP_HELPERS_H_
+
+#include <glad/glad.h>
+
+#include <vector>
+
+/**
+ * Collects helper functions that build mip chains on the CPU, so that each kind of texture can be filtered correctly.
+ */
+namespace help {
+  /**
+   * How the first three channels are averaged. A 4th channel is always averaged as stored.
+   */
+  enum MipFilter {
+    MIP_FILTER_COLOR,  // averaged in linear space, assuming a gamma of 2.2 (matching the shaders)
+    MIP_FILTER_LINEAR, // averaged as stored
+    MIP_FILTER_NORMAL  // decoded from [0, 1] to [-1, 1], averaged and renormalized
+  };
+
+  /**
+   * @returns   The number of levels in a full mip chain for the given dimensions.
+   */
+  [[nodiscard]] GLsizei getNumMipLevels(GLsizei width, GLsizei height);
+
+  /**
+   * Builds a mip chain by repeatedly averaging 2x2 texels of the previous level (clamped at the edges).
+   *
+   * @param rgb           width * height * num_channels bytes, tightly packed.
+   * @param num_channels  3 (RGB) or 4 (RGBA).
+   * @param num_levels    The number of levels to build, including the full resolution one.
+   *
+   * @returns   Every level, tightly packed like the input, starting with a copy of it. Level i has dimensions
+   *            max(width >> i, 1) x max(height >> i, 1).
+   */
+  [[nodiscard]] std::vector<std::vector<unsigned char>> generateMipLevels(const unsigned char* rgb,
+                                                                          GLsizei width,
+                                                                          GLsizei height,
+                                                                          GLsizei num_channels,
+                                                                          GLsizei num_levels,
+                                                                          MipFilter filter);
+}
+#endif //TEMPLEGL_SRC_MIPMAP_HELPERS_H_
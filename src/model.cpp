@@ -1,36 +1,134 @@
 #include "model.h"
 #include "stbi_helpers.h"
+#include "mesh_optimization_helpers.h"
+#include "file_helpers.h"
+#include "cpu_profiler.h"
 
 #include <glad/glad.h>
 #include <assimp/postprocess.h>
+#include <glm/gtc/packing.hpp>
 
 #include <format>
 #include <filesystem>
+#include <fstream>
+#include <chrono>
 #include <cstring>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <iostream>
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
 
-Model::Model(std::string folder_path)
-  : source_dir_ {std::move(folder_path)} {
-  loadModelData();
-  loadLightData();
+/**
+ * Reinterprets a section of the model cache as an array of T. The section must be suitably aligned.
+ */
+template <typename T>
+static std::span<const T> viewAs(const std::span<const std::byte> bytes) {
+  return {reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T)};
 }
 
-void Model::drawSetup(const GLuint vertex_buffer_binding, const GLuint texture_binding) const {
+Model::Model(std::string folder_path, const LoadOptions options, std::function<void(float)> report_progress)
+  : source_dir_ {std::move(folder_path)}, options_ {options}, report_progress_ {std::move(report_progress)} {
+  PROFILE_ZONE("Model::Model");
+  const auto start_time {std::chrono::steady_clock::now()};
+  const bool cached {options_.use_cache && loadCache()};
+  if (!cached) {
+    loadLightData();
+    loadModelData();
+  }
+  std::cout << std::format("INFO (Model::Model): Loaded '{}' {}in {} ms.",
+                           source_dir_,
+                           cached ? "from cache " : "",
+                           std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                                                 - start_time).count())
+            << std::endl;
+}
+
+void Model::drawSetup(const GLuint vertex_buffer_binding,
+                      const GLuint diffuse_binding,
+                      const GLuint normal_binding,
+                      const GLuint specular_binding) const {
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, vertex_buffer_binding, vertex_buffer_.id);
-  glBindTextureUnit(texture_binding, texture_array_.id);
+  glBindTextureUnit(diffuse_binding, diffuse_array_.id);
+  glBindTextureUnit(normal_binding, normal_array_.id);
+  glBindTextureUnit(specular_binding, specular_array_.id);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_.id);
   glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw_command_buffer_.id);
 }
 
+void Model::cullSetup(const GLuint bounds_binding,
+                      const GLuint cone_binding,
+                      const GLuint lod_binding,
+                      const GLuint command_binding,
+                      const GLuint culled_command_binding,
+                      const GLuint draw_count_binding,
+                      const GLuint visibility_binding) {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bounds_binding, draw_bounds_buffer_.id);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cone_binding, draw_cone_buffer_.id);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, lod_binding, draw_lod_buffer_.id);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, command_binding, draw_command_buffer_.id);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, visibility_binding, draw_visibility_buffer_.id);
+  culled_command_binding_ = culled_command_binding;
+  draw_count_binding_     = draw_count_binding;
+}
+
+size_t Model::createCulledDrawList(const GLsizei max_commands_per_draw) {
+  auto list {std::make_unique<CulledDrawList>()};
+  list->max_draw_count = num_draw_commands_ * max_commands_per_draw;
+  glCreateBuffers(1, &list->command_buffer.id);
+  glNamedBufferStorage(list->command_buffer.id,
+                       static_cast<GLsizeiptr>(list->max_draw_count * sizeof(DrawElementsIndirectCommand)),
+                       nullptr,
+                       0);
+  glCreateBuffers(1, &list->count_buffer.id);
+  glNamedBufferStorage(list->count_buffer.id, sizeof(GLuint), nullptr, 0);
+  culled_draw_lists_.push_back(std::move(list));
+  return culled_draw_lists_.size() - 1;
+}
+
+void Model::cull(const std::unique_ptr<ShaderProgram>& shader, const size_t list_index) const {
+  const CulledDrawList& list {*culled_draw_lists_[list_index]};
+  glClearNamedBufferData(list.count_buffer.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, culled_command_binding_, list.command_buffer.id);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, draw_count_binding_, list.count_buffer.id);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  shader->use();
+  glDispatchCompute((static_cast<GLuint>(num_draw_commands_) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
 void Model::loadModelData() {
+  PROFILE_ZONE("Model::loadModelData");
   const std::string path {source_dir_ + "model.obj"};
   const aiScene* scene {importer_.ReadFile(path.c_str(),
                                            aiProcess_FlipUVs |
                                            aiProcess_Triangulate |
                                            aiProcess_GenNormals |
-                                           aiProcess_CalcTangentSpace)};
+                                           aiProcess_CalcTangentSpace |
+                                           (options_.optimize_geometry ? aiProcess_JoinIdenticalVertices : 0))};
   checkAssimpSceneErrors(scene, path);
-  createTextureArray(scene->mMaterials, scene->mNumMaterials);
-  createBuffers(scene->mMeshes, scene->mNumMeshes);
+  reportProgress(0.25f);
+  std::vector<std::string> material_names;
+  for (unsigned int i = 0; i < scene->mNumMaterials; ++i) {
+    material_names.emplace_back(scene->mMaterials[i]->GetName().C_Str());
+  }
+  createTextureArrays(material_names);
+  reportProgress(0.5f);
+  const GeometryData geometry {createGeometry(scene->mMeshes, scene->mNumMeshes)};
+  reportProgress(0.9f);
+  const GeometryView geometry_view {geometry.vertex_data,
+                                    geometry.index_data,
+                                    geometry.index_type,
+                                    geometry.draw_commands,
+                                    geometry.draw_bounds,
+                                    geometry.draw_cones,
+                                    geometry.draw_lods};
+  createBuffers(geometry_view);
+  if (options_.use_cache) writeCache(geometry_view, material_names);
+  reportProgress(1.0f);
   glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
                        GL_DEBUG_TYPE_OTHER,
                        0,
@@ -40,6 +138,7 @@ void Model::loadModelData() {
 }
 
 void Model::loadLightData() {
+  PROFILE_ZONE("Model::loadLightData");
   const std::string path {source_dir_ + "lights.obj"};
   if (!std::filesystem::exists(path)) return;
   const aiScene* scene {importer_.ReadFile(path.c_str(), 0)};
@@ -65,47 +164,556 @@ void Model::loadLightData() {
                        "(Model::loadLightData): Completed successfully.");
 }
 
-void Model::createTextureArray(aiMaterial** materials, const unsigned int num_materials) {
-  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture_array_.id);
-  glTextureStorage3D(texture_array_.id, 1, GL_RGB8, TEX_SIZE, TEX_SIZE, static_cast<GLsizei>(num_materials) * 3);
-  GLint layer {0};
-  for (unsigned int i = 0; i < num_materials; ++i) {
-    auto material_name {materials[i]->GetName().C_Str()};
-    for (auto folder : {"diffuse/", "normal/", "specular/"}) {
-      std::string path {source_dir_ + folder + material_name + ".png"};
-      if (!std::filesystem::exists(path)) {
-        glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
-                             GL_DEBUG_TYPE_OTHER,
-                             texture_array_.id,
-                             GL_DEBUG_SEVERITY_NOTIFICATION,
-                             -1,
-                             std::format("(Model::createTextureArray): Using default {} texture for material '{}.'",
-                                         folder,
-                                         material_name).c_str());
-        path = source_dir_ + folder + "DefaultMaterial.png";
-      }
-      help::fill3DTextureLayer(path, texture_array_, layer, TEX_SIZE, TEX_SIZE);
-      ++layer;
+bool Model::loadCache() {
+  PROFILE_ZONE("Model::loadCache");
+  const std::string path {source_dir_ + CACHE_FILE_NAME};
+  const help::MappedFile file {path};
+  const std::span<const std::byte> data {file.data()};
+  if (data.empty()) return false;
+
+  /// Reject caches written by another version, with other load options, or for other source files
+  CacheHeader header {};
+  if (data.size() < sizeof(header)) return false;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.key != getCacheKey()) {
+    std::cout << std::format("INFO (Model::loadCache): Cache '{}' is out of date, rebuilding it.", path) << std::endl;
+    return false;
+  }
+  const auto rejectCorrupt {[&path] {
+    std::cerr << std::format("WARNING (Model::loadCache): Cache '{}' is corrupt, rebuilding it.", path) << std::endl;
+    return false;
+  }};
+  for (size_t section = 0; section < NUM_CACHE_SECTIONS; ++section) {
+    if (header.section_offset[section] % CACHE_SECTION_ALIGNMENT != 0
+        || header.section_offset[section] > data.size()
+        || header.section_size[section] > data.size() - header.section_offset[section]) return rejectCorrupt();
+  }
+
+  /// The sections are used in place. Their offsets are aligned, and the mapping itself starts at a page boundary.
+  const auto getSection {[&](const CacheSection section) {
+    return data.subspan(header.section_offset[section], header.section_size[section]);
+  }};
+  const GeometryView geometry {getSection(CacheSection::VERTEX),
+                               getSection(CacheSection::INDEX),
+                               header.index_type,
+                               viewAs<DrawElementsIndirectCommand>(getSection(CacheSection::DRAW_COMMAND)),
+                               viewAs<DrawBounds>(getSection(CacheSection::DRAW_BOUNDS)),
+                               viewAs<DrawCone>(getSection(CacheSection::DRAW_CONE)),
+                               viewAs<DrawLod>(getSection(CacheSection::DRAW_LOD))};
+  const std::span light_positions {viewAs<glm::vec4>(getSection(CacheSection::LIGHT_POSITION))};
+  const std::span material_name_data {viewAs<char>(getSection(CacheSection::MATERIAL_NAME))};
+
+  /// Reject typed sections that are not whole arrays, and per-draw sections of different lengths, since the cull
+  /// shaders index all per-draw buffers with the same draw index
+  const auto isWholeArray {[&](const auto view, const CacheSection section) {
+    return view.size_bytes() == header.section_size[section];
+  }};
+  const size_t index_size {header.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)};
+  const size_t num_draws {geometry.draw_commands.size()};
+  if (geometry.index_data.size() % index_size != 0
+      || !isWholeArray(geometry.draw_commands, CacheSection::DRAW_COMMAND)
+      || !isWholeArray(geometry.draw_bounds, CacheSection::DRAW_BOUNDS)
+      || !isWholeArray(geometry.draw_cones, CacheSection::DRAW_CONE)
+      || !isWholeArray(geometry.draw_lods, CacheSection::DRAW_LOD)
+      || !isWholeArray(light_positions, CacheSection::LIGHT_POSITION)
+      || geometry.draw_bounds.size() != num_draws
+      || geometry.draw_cones.size() != num_draws
+      || geometry.draw_lods.size() != num_draws) return rejectCorrupt();
+
+  std::vector<std::string> material_names;
+  for (auto name_begin {material_name_data.begin()}; name_begin != material_name_data.end();) {
+    const auto name_end {std::find(name_begin, material_name_data.end(), '\0')};
+    material_names.emplace_back(name_begin, name_end);
+    name_begin = name_end == material_name_data.end() ? name_end : name_end + 1;
+  }
+  createTextureArrays(material_names);
+  reportProgress(0.7f);
+  createBuffers(geometry);
+  reportProgress(1.0f);
+  light_positions_.assign(light_positions.begin(), light_positions.end());
+  glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                       GL_DEBUG_TYPE_OTHER,
+                       0,
+                       GL_DEBUG_SEVERITY_NOTIFICATION,
+                       -1,
+                       "(Model::loadCache): Completed successfully.");
+  return true;
+}
+
+void Model::writeCache(const GeometryView& geometry, const std::span<const std::string> material_names) const {
+  PROFILE_ZONE("Model::writeCache");
+  std::string material_name_data;
+  for (const std::string& name : material_names) {
+    material_name_data += name;
+    material_name_data += '\0';
+  }
+  const std::array<std::span<const std::byte>, NUM_CACHE_SECTIONS> sections {
+    geometry.vertex_data,
+    geometry.index_data,
+    std::as_bytes(geometry.draw_commands),
+    std::as_bytes(geometry.draw_bounds),
+    std::as_bytes(geometry.draw_cones),
+    std::as_bytes(geometry.draw_lods),
+    std::as_bytes(std::span {light_positions_}),
+    std::as_bytes(std::span {material_name_data})
+  };
+  CacheHeader header {getCacheKey(), geometry.index_type};
+  size_t offset {sizeof(header)};
+  for (size_t section = 0; section < NUM_CACHE_SECTIONS; ++section) {
+    offset = (offset + CACHE_SECTION_ALIGNMENT - 1) / CACHE_SECTION_ALIGNMENT * CACHE_SECTION_ALIGNMENT;
+    header.section_offset[section] = offset;
+    header.section_size[section]   = sections[section].size();
+    offset += sections[section].size();
+  }
+
+  /// Write to a temporary file first, so that an interrupted write never leaves a cache that looks valid
+  const std::string path {source_dir_ + CACHE_FILE_NAME};
+  const std::string temporary_path {path + ".tmp"};
+  {
+    std::ofstream file {temporary_path, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t section = 0; section < NUM_CACHE_SECTIONS; ++section) {
+      const std::vector<char> padding(header.section_offset[section] - static_cast<size_t>(file.tellp()));
+      file.write(padding.data(), std::ssize(padding));
+      file.write(reinterpret_cast<const char*>(sections[section].data()), std::ssize(sections[section]));
+    }
+    if (!file) {
+      std::cerr << std::format("WARNING (Model::writeCache): Failed to write cache '{}'.", temporary_path)
+                << std::endl;
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary_path, path, error);
+  if (error) {
+    std::cerr << std::format("WARNING (Model::writeCache): Failed to replace cache '{}'. Reason: '{}'",
+                             path,
+                             error.message())
+              << std::endl;
+    return;
+  }
+  std::cout << std::format("INFO (Model::writeCache): Wrote {} KiB to '{}'.", offset >> 10, path) << std::endl;
+}
+
+Model::CacheKey Model::getCacheKey() const {
+  return {CACHE_MAGIC,
+          CACHE_VERSION,
+          help::getFileStamp(source_dir_ + "model.obj"),
+          help::getFileStamp(source_dir_ + "lights.obj"),
+          options_.merge_cell_size,
+          options_.meshlet_max_triangles,
+          options_.compressed_vertices,
+          options_.optimize_geometry,
+          options_.lod_levels};
+}
+
+void Model::createTextureArrays(const std::span<const std::string> material_names) {
+  PROFILE_ZONE("Model::createTextureArrays");
+  if (options_.packed_materials) {
+    createTextureArray(diffuse_array_, "diffuse/", "specular/", material_names, GL_RGBA8, help::BC3_RGBA,
+                       help::MIP_FILTER_COLOR);
+    createTextureArray(normal_array_, "normal/", "", material_names, GL_RG8, help::BC5_RG, help::MIP_FILTER_NORMAL);
+  } else {
+    createTextureArray(diffuse_array_, "diffuse/", "", material_names, GL_RGB8, help::BC1_RGB, help::MIP_FILTER_COLOR);
+    createTextureArray(normal_array_, "normal/", "", material_names, GL_RGB8, help::BC5_RG, help::MIP_FILTER_NORMAL);
+    createTextureArray(specular_array_, "specular/", "", material_names, GL_R8, help::BC4_R,
+                       help::MIP_FILTER_LINEAR);
+  }
+  glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                       GL_DEBUG_TYPE_OTHER,
+                       0,
+                       GL_DEBUG_SEVERITY_NOTIFICATION,
+                       -1,
+                       "(Model::createTextureArrays): Completed successfully.");
+}
+
+void Model::createTextureArray(wrap::Texture& texture,
+                               const std::string& folder,
+                               const std::string& alpha_folder,
+                               const std::span<const std::string> material_names,
+                               const GLenum internal_format,
+                               const help::BlockFormat compressed_format,
+                               const help::MipFilter mip_filter) const {
+  std::vector<std::string> paths;
+  std::vector<std::string> alpha_paths;
+  std::vector<std::string> baked_paths;
+  for (const std::string& material_name : material_names) {
+    paths.push_back(getTexturePath(folder, material_name));
+    if (alpha_folder.empty()) {
+      baked_paths.push_back(help::getCompressedTexturePath(paths.back()));
+    } else {
+      // Packed layers combine two files, so they are baked per material rather than per file
+      alpha_paths.push_back(getTexturePath(alpha_folder, material_name));
+      baked_paths.push_back(source_dir_ + "packed/" + material_name + ".ktx2");
     }
   }
-  glTextureParameteri(texture_array_.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTextureParameteri(texture_array_.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture.id);
+  if (options_.compressed_textures) {
+    help::bakeCompressedTextures(paths,
+                                 alpha_paths,
+                                 baked_paths,
+                                 compressed_format,
+                                 TEX_SIZE,
+                                 TEX_SIZE,
+                                 TEX_NUM_LEVELS,
+                                 mip_filter);
+    glTextureStorage3D(texture.id,
+                       TEX_NUM_LEVELS,
+                       help::getBlockFormatInternalFormat(compressed_format),
+                       TEX_SIZE,
+                       TEX_SIZE,
+                       static_cast<GLsizei>(std::ssize(paths)));
+    help::fill3DTextureLayersCompressed(baked_paths,
+                                        texture,
+                                        0,
+                                        TEX_SIZE,
+                                        TEX_SIZE,
+                                        TEX_NUM_LEVELS,
+                                        compressed_format);
+  } else {
+    glTextureStorage3D(texture.id,
+                       TEX_NUM_LEVELS,
+                       internal_format,
+                       TEX_SIZE,
+                       TEX_SIZE,
+                       static_cast<GLsizei>(std::ssize(paths)));
+    help::fill3DTextureLayers(paths, alpha_paths, texture, 0, TEX_SIZE, TEX_SIZE, TEX_NUM_LEVELS, mip_filter);
+  }
+  glTextureParameteri(texture.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTextureParameteri(texture.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  if (options_.max_anisotropy > 1.0f) {
+    GLfloat supported_anisotropy;
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &supported_anisotropy);
+    glTextureParameterf(texture.id, GL_TEXTURE_MAX_ANISOTROPY, std::min(options_.max_anisotropy, supported_anisotropy));
+  }
+}
+
+std::string Model::getTexturePath(const std::string& folder, const std::string& material_name) const {
+  const std::string path {source_dir_ + folder + material_name + ".png"};
+  if (std::filesystem::exists(path)
+      || (options_.compressed_textures && std::filesystem::exists(help::getCompressedTexturePath(path)))) {
+    return path;
+  }
   glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
                        GL_DEBUG_TYPE_OTHER,
-                       texture_array_.id,
+                       0,
                        GL_DEBUG_SEVERITY_NOTIFICATION,
                        -1,
-                       "(Model::createTextureArray): Completed successfully.");
+                       std::format("(Model::getTexturePath): Using default {} texture for material '{}.'",
+                                   folder,
+                                   material_name).c_str());
+  return source_dir_ + folder + "DefaultMaterial.png";
 }
 
-void Model::createBuffers(aiMesh** meshes, const unsigned int num_meshes) {
+Model::GeometryData Model::createGeometry(aiMesh** meshes, const unsigned int num_meshes) {
+  PROFILE_ZONE("Model::createGeometry");
   std::vector<Vertex> vertices;
   std::vector<GLuint> indices;
   std::vector<DrawElementsIndirectCommand> draw_commands;
-  draw_commands.reserve(num_meshes);
+  std::vector<DrawBounds> draw_bounds;
+  std::vector<DrawCone> draw_cones;
+  std::vector<DrawLod> draw_lods;
+  const std::vector<std::vector<const aiMesh*>> batches {batchMeshes(meshes, num_meshes)};
 
+  /// Every batch shares one base vertex. Indices of later meshes in a batch are offset by the vertices before them.
   GLint base_vertex {0};
-  GLuint first_index {0};
+  size_t cache_misses_before {0};
+  size_t cache_misses_after {0};
+  std::array<size_t, MAX_LOD_LEVELS> lod_num_indices {};
+  for (const std::vector<const aiMesh*>& batch : batches) {
+    std::vector<GLuint> batch_indices;
+    GLuint batch_num_vertices {0};
+    for (const aiMesh* mesh : batch) {
+      for (unsigned int j = 0; j < mesh->mNumVertices; ++j) {
+        vertices.emplace_back(Vertex {{mesh->mVertices[j].x,
+                                       mesh->mVertices[j].y,
+                                       mesh->mVertices[j].z},
+                                      {mesh->mTangents[j].x,
+                                       mesh->mTangents[j].y,
+                                       mesh->mTangents[j].z},
+                                      {mesh->mBitangents[j].x,
+                                       mesh->mBitangents[j].y,
+                                       mesh->mBitangents[j].z},
+                                      {mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j].x : 0.0f,
+                                       mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j].y : 0.0f}});
+      }
+      for (unsigned int j = 0; j < mesh->mNumFaces; ++j) {
+        const aiFace& face {mesh->mFaces[j]};
+        batch_indices.emplace_back(batch_num_vertices + face.mIndices[0]);
+        batch_indices.emplace_back(batch_num_vertices + face.mIndices[1]);
+        batch_indices.emplace_back(batch_num_vertices + face.mIndices[2]);
+      }
+      batch_num_vertices += mesh->mNumVertices;
+    }
+
+    /// Split the batch into meshlets (or keep it whole), and emit a draw command with bounds and cone for each
+    const std::span<const Vertex> batch_vertices {vertices.end() - batch_num_vertices, vertices.end()};
+    const size_t batch_first_index {indices.size()};
+    std::vector<glm::vec3> batch_positions;
+    if (options_.lod_levels > 0) {
+      batch_positions.reserve(batch_num_vertices);
+      for (const Vertex& vertex : batch_vertices) {
+        batch_positions.emplace_back(vertex.position[0], vertex.position[1], vertex.position[2]);
+      }
+    }
+    std::vector<std::vector<GLuint>> meshlets {buildMeshlets(batch_vertices, batch_indices)};
+    const size_t batch_first_draw {draw_lods.size()};
+    for (std::vector<GLuint>& meshlet : meshlets) {
+      if (options_.optimize_geometry) {
+        cache_misses_before += help::countVertexCacheMisses(meshlet, VERTEX_CACHE_SIZE);
+        help::optimizeVertexCache(meshlet, VERTEX_CACHE_SIZE);
+        cache_misses_after += help::countVertexCacheMisses(meshlet, VERTEX_CACHE_SIZE);
+      }
+      draw_commands.emplace_back(static_cast<GLuint>(meshlet.size()),
+                                 1,
+                                 static_cast<GLuint>(indices.size()),
+                                 base_vertex,
+                                 batch.front()->mMaterialIndex);
+      draw_lods.push_back({1, {static_cast<GLuint>(indices.size())}, {static_cast<GLuint>(meshlet.size())}, {0.0f}});
+      indices.insert(indices.end(), meshlet.begin(), meshlet.end());
+      const auto [bounds, cone] {computeDrawBounds(batch_vertices, meshlet)};
+      draw_bounds.push_back(bounds);
+      draw_cones.push_back(cone);
+    }
+    /// Coarser levels go after the full detail of every meshlet, so that the cull shaders can merge the commands of
+    /// neighbouring meshlets whose index ranges follow each other
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+      DrawLod& lod {draw_lods[batch_first_draw + i]};
+      if (options_.lod_levels > 0) appendLods(batch_positions, meshlets[i], lod, indices);
+      for (GLuint level = 0; level < MAX_LOD_LEVELS; ++level) {
+        // Draws without a level use their coarsest one
+        lod_num_indices[level] += lod.count[std::min(level, lod.num_levels - 1)];
+      }
+    }
+    if (options_.optimize_geometry) {
+      /// Store the vertices of the batch in the order they are first used
+      const std::span batch_draw_indices {indices.begin() + static_cast<std::ptrdiff_t>(batch_first_index),
+                                          indices.end()};
+      const std::vector<GLuint> remap {help::getVertexFetchRemap(batch_draw_indices, batch_num_vertices)};
+      const std::vector<Vertex> old_vertices {batch_vertices.begin(), batch_vertices.end()};
+      const auto batch_first_vertex {vertices.end() - batch_num_vertices};
+      for (GLuint v = 0; v < batch_num_vertices; ++v) { batch_first_vertex[remap[v]] = old_vertices[v]; }
+      for (GLuint& index : batch_draw_indices) { index = remap[index]; }
+    }
+    base_vertex += static_cast<GLint>(batch_num_vertices);
+  }
+  if (options_.optimize_geometry) {
+    const auto num_triangles {static_cast<double>(lod_num_indices[0] / 3)};
+    const auto num_vertices {static_cast<double>(vertices.size())};
+    std::cout << std::format("INFO (Model::createGeometry): {} vertices after welding ({} triangles). Vertex cache "
+                             "ACMR: {:.3f} -> {:.3f}, ATVR: {:.3f} -> {:.3f}.",
+                             vertices.size(),
+                             lod_num_indices[0] / 3,
+                             static_cast<double>(cache_misses_before) / num_triangles,
+                             static_cast<double>(cache_misses_after) / num_triangles,
+                             static_cast<double>(cache_misses_before) / num_vertices,
+                             static_cast<double>(cache_misses_after) / num_vertices)
+              << std::endl;
+  }
+  if (options_.meshlet_max_triangles > 0) {
+    std::cout << std::format("INFO (Model::createGeometry): Split {} draws into {} meshlets.",
+                             batches.size(),
+                             draw_commands.size())
+              << std::endl;
+  }
+
+  if (options_.lod_levels > 0) {
+    std::string report {"INFO (Model::createGeometry): Triangles per level of detail:"};
+    for (GLuint level = 0; level < MAX_LOD_LEVELS && level <= options_.lod_levels; ++level) {
+      report += std::format(" {}", lod_num_indices[level] / 3);
+    }
+    std::cout << report << std::endl;
+  }
+
+  GeometryData geometry;
+  encodeVertexAndIndexData(vertices, indices, draw_commands, draw_lods, geometry);
+  geometry.draw_commands = std::move(draw_commands);
+  geometry.draw_bounds   = std::move(draw_bounds);
+  geometry.draw_cones    = std::move(draw_cones);
+  geometry.draw_lods     = std::move(draw_lods);
+  return geometry;
+}
+
+void Model::createBuffers(const GeometryView& geometry) {
+  PROFILE_ZONE("Model::createBuffers");
+  num_draw_commands_ = static_cast<GLsizei>(std::ssize(geometry.draw_commands));
+  index_type_        = geometry.index_type;
+  createBufferFromData(vertex_buffer_, geometry.vertex_data);
+  createBufferFromData(index_buffer_, geometry.index_data);
+  createBufferFromData(draw_command_buffer_, std::as_bytes(geometry.draw_commands));
+  createBufferFromData(draw_lod_buffer_, std::as_bytes(geometry.draw_lods));
+  createBufferFromData(draw_bounds_buffer_, std::as_bytes(geometry.draw_bounds));
+  createBufferFromData(draw_cone_buffer_, std::as_bytes(geometry.draw_cones));
+  createCulledDrawList(1);
+  glCreateBuffers(1, &draw_visibility_buffer_.id);
+  glNamedBufferStorage(draw_visibility_buffer_.id,
+                       static_cast<GLsizeiptr>(num_draw_commands_ * sizeof(GLuint)),
+                       nullptr,
+                       0);
+  glClearNamedBufferData(draw_visibility_buffer_.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                       GL_DEBUG_TYPE_OTHER,
+                       0,
+                       GL_DEBUG_SEVERITY_NOTIFICATION,
+                       -1,
+                       "(Model::createBuffers): Completed successfully.");
+}
+
+std::vector<std::vector<GLuint>> Model::buildMeshlets(const std::span<const Vertex> vertices,
+                                                      const std::vector<GLuint>& indices) const {
+  if (options_.meshlet_max_triangles == 0) return {indices};
+
+  /// Find the centroid and normal of every triangle, and the triangles around every vertex
+  const auto position {[&vertices](const GLuint index) {
+    return glm::vec3(vertices[index].position[0], vertices[index].position[1], vertices[index].position[2]);
+  }};
+  const size_t num_triangles {indices.size() / 3};
+  std::vector<glm::vec3> centroids(num_triangles, glm::vec3(0.0f));
+  std::vector<glm::vec3> normals(num_triangles);
+  std::vector<GLuint> vertex_triangle_offsets(vertices.size() + 1, 0);
+  for (size_t t = 0; t < num_triangles; ++t) {
+    for (size_t j = t * 3; j < t * 3 + 3; ++j) {
+      centroids[t] += position(indices[j]) / 3.0f;
+      ++vertex_triangle_offsets[indices[j] + 1];
+    }
+    normals[t] = getTriangleNormal(vertices, indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]);
+  }
+  std::partial_sum(vertex_triangle_offsets.begin(), vertex_triangle_offsets.end(), vertex_triangle_offsets.begin());
+  std::vector<GLuint> vertex_triangles(num_triangles * 3);
+  std::vector<GLuint> vertex_triangle_ends {vertex_triangle_offsets.begin(), vertex_triangle_offsets.end() - 1};
+  for (size_t j = 0; j < num_triangles * 3; ++j) {
+    vertex_triangles[vertex_triangle_ends[indices[j]]++] = static_cast<GLuint>(j / 3);
+  }
+
+  /// Grow every meshlet from a seed triangle across shared vertices, taking the neighbour that best keeps its normal
+  /// cone narrow and its bounds compact. A meshlet is closed once it is full, once it runs out of neighbours, or when
+  /// every neighbour faces away from its average normal (which would make the cone useless for culling). The next
+  /// seed is a neighbour of the previous meshlet if one is left, so consecutive meshlets are close to each other.
+  std::vector<std::vector<GLuint>> meshlets;
+  std::vector<bool> assigned(num_triangles, false);
+  std::vector<GLuint> candidates; // unassigned triangles that share a vertex with the current meshlet (may repeat)
+  size_t next_in_order {0};
+  const size_t max_indices {options_.meshlet_max_triangles * 3};
+  while (true) {
+    std::erase_if(candidates, [&assigned](const GLuint t) { return assigned[t]; });
+    GLuint triangle;
+    if (!candidates.empty()) {
+      triangle = candidates.front();
+    } else {
+      while (next_in_order < num_triangles && assigned[next_in_order]) ++next_in_order;
+      if (next_in_order == num_triangles) break;
+      triangle = static_cast<GLuint>(next_in_order);
+    }
+    candidates.clear();
+    std::vector<GLuint>& meshlet {meshlets.emplace_back()};
+    const glm::vec3 seed_centroid {centroids[triangle]};
+    glm::vec3 centroid_sum {0.0f};
+    glm::vec3 normal_sum {0.0f};
+    float radius {0.0f}; // around the seed centroid, only used to make distances relative
+    while (true) {
+      assigned[triangle] = true;
+      centroid_sum += centroids[triangle];
+      normal_sum += normals[triangle];
+      for (size_t j = triangle * 3; j < triangle * 3 + 3; ++j) {
+        meshlet.push_back(indices[j]);
+        radius = std::max(radius, glm::distance(position(indices[j]), seed_centroid));
+        for (GLuint k = vertex_triangle_offsets[indices[j]]; k < vertex_triangle_offsets[indices[j] + 1]; ++k) {
+          if (!assigned[vertex_triangles[k]]) candidates.push_back(vertex_triangles[k]);
+        }
+      }
+      if (meshlet.size() >= max_indices) break;
+
+      std::erase_if(candidates, [&assigned](const GLuint t) { return assigned[t]; });
+      const glm::vec3 center {centroid_sum / static_cast<float>(meshlet.size() / 3)};
+      const glm::vec3 axis {glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::vec3(0.0f)};
+      float best_score {std::numeric_limits<float>::lowest()};
+      for (const GLuint candidate : candidates) {
+        const float alignment {glm::dot(normals[candidate], axis)};
+        // Degenerate triangles have no normal, and always fit
+        if (alignment <= 0.0f && normals[candidate] != glm::vec3(0.0f) && axis != glm::vec3(0.0f)) continue;
+        const float score {alignment - glm::distance(centroids[candidate], center) / std::max(radius, 1e-6f)};
+        if (score > best_score) {
+          best_score = score;
+          triangle   = candidate;
+        }
+      }
+      if (best_score == std::numeric_limits<float>::lowest()) break;
+    }
+  }
+  return meshlets;
+}
+
+std::pair<Model::DrawBounds, Model::DrawCone> Model::computeDrawBounds(const std::span<const Vertex> vertices,
+                                                                       const std::vector<GLuint>& indices) {
+  glm::vec3 min_point {std::numeric_limits<float>::max()};
+  glm::vec3 max_point {std::numeric_limits<float>::lowest()};
+  glm::vec3 normal_sum {0.0f};
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    for (size_t j = i; j < i + 3; ++j) {
+      const glm::vec3 position {vertices[indices[j]].position[0],
+                                vertices[indices[j]].position[1],
+                                vertices[indices[j]].position[2]};
+      min_point = glm::min(min_point, position);
+      max_point = glm::max(max_point, position);
+    }
+    normal_sum += getTriangleNormal(vertices, indices[i], indices[i + 1], indices[i + 2]);
+  }
+  const glm::vec3 center {(min_point + max_point) / 2.0f};
+  const float radius {glm::distance(min_point, max_point) / 2.0f};
+
+  /// The cone axis is the average normal, and its half-angle reaches the normal furthest from it. Culling is only safe
+  /// while that angle is below 90 degrees, i.e. while every normal lies in the same hemisphere as the axis.
+  float cutoff {1.0f};
+  if (glm::length(normal_sum) > 0.0f) {
+    const glm::vec3 axis {glm::normalize(normal_sum)};
+    float min_dot {1.0f};
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const glm::vec3 normal {getTriangleNormal(vertices, indices[i], indices[i + 1], indices[i + 2])};
+      if (normal != glm::vec3(0.0f)) min_dot = glm::min(min_dot, glm::dot(axis, normal));
+    }
+    if (min_dot > 0.0f) cutoff = std::sqrt(1.0f - min_dot * min_dot); // sin(half-angle)
+    normal_sum = axis;
+  }
+  return {DrawBounds {glm::vec4(min_point, 1.0f), glm::vec4(max_point, 1.0f)},
+          DrawCone {glm::vec4(center, radius), glm::vec4(normal_sum, cutoff)}};
+}
+
+void Model::appendLods(const std::span<const glm::vec3> positions,
+                       const std::vector<GLuint>& draw_indices,
+                       DrawLod& lod,
+                       std::vector<GLuint>& indices) const {
+  /// Every level is simplified from full detail, so that its error is measured against the original surface
+  for (GLuint level = 1; level <= options_.lod_levels && level < MAX_LOD_LEVELS; ++level) {
+    const size_t target_index_count {draw_indices.size() / 3 >> level};
+    float error;
+    std::vector<GLuint> simplified {help::simplifyMesh(draw_indices, positions, target_index_count * 3, error)};
+    if (simplified.size() * 10 > lod.count[level - 1] * 9) break;
+    if (options_.optimize_geometry) help::optimizeVertexCache(simplified, VERTEX_CACHE_SIZE);
+    lod.first_index[level] = static_cast<GLuint>(indices.size());
+    lod.count[level]       = static_cast<GLuint>(simplified.size());
+    lod.error[level]       = std::max(error, lod.error[level - 1]);
+    lod.num_levels         = level + 1;
+    indices.insert(indices.end(), simplified.begin(), simplified.end());
+  }
+}
+
+glm::vec3 Model::getTriangleNormal(const std::span<const Vertex> vertices,
+                                   const GLuint a,
+                                   const GLuint b,
+                                   const GLuint c) {
+  const auto position {[&vertices](const GLuint index) {
+    return glm::vec3(vertices[index].position[0], vertices[index].position[1], vertices[index].position[2]);
+  }};
+  const glm::vec3 normal {glm::cross(position(b) - position(a), position(c) - position(a))};
+  // Degenerate triangles have no facing, and are ignored by the cone
+  return glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+}
+
+std::vector<std::vector<const aiMesh*>> Model::batchMeshes(aiMesh** meshes, const unsigned int num_meshes) const {
+  std::vector<std::vector<const aiMesh*>> batches;
+  std::map<std::tuple<unsigned int, int, int, int>, size_t> batch_indices; // (material, cell) -> index into batches
+  size_t num_batched_meshes {0}; // excludes skipped meshes
   for (unsigned int i = 0; i < num_meshes; ++i) {
     const aiMesh* mesh {meshes[i]};
     if (mesh->mPrimitiveTypes != (aiPrimitiveType_TRIANGLE | aiPrimitiveType_NGONEncodingFlag)) {
@@ -114,48 +722,141 @@ void Model::createBuffers(aiMesh** meshes, const unsigned int num_meshes) {
                            0,
                            GL_DEBUG_SEVERITY_MEDIUM,
                            -1,
-                           "(Model::createBuffers): Detected point/line primitives in mesh, which are not allowed. "
+                           "(Model::batchMeshes): Detected point/line primitives in mesh, which are not allowed. "
                            "This mesh will be skipped.");
       continue;
     }
-    draw_commands.emplace_back(mesh->mNumFaces * 3, 1, first_index, base_vertex, mesh->mMaterialIndex);
+    ++num_batched_meshes;
+    if (options_.merge_cell_size <= 0.0f) {
+      batches.push_back({mesh});
+      continue;
+    }
+    glm::vec3 min_point {std::numeric_limits<float>::max()};
+    glm::vec3 max_point {std::numeric_limits<float>::lowest()};
     for (unsigned int j = 0; j < mesh->mNumVertices; ++j) {
-      vertices.emplace_back(Vertex {{mesh->mVertices[j].x,
-                                     mesh->mVertices[j].y,
-                                     mesh->mVertices[j].z},
-                                    {mesh->mTangents[j].x,
-                                     mesh->mTangents[j].y,
-                                     mesh->mTangents[j].z},
-                                    {mesh->mBitangents[j].x,
-                                     mesh->mBitangents[j].y,
-                                     mesh->mBitangents[j].z},
-                                    {mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j].x : 0.0f,
-                                     mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j].y : 0.0f}});
-      ++base_vertex;
+      const glm::vec3 position {mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z};
+      min_point = glm::min(min_point, position);
+      max_point = glm::max(max_point, position);
     }
-    for (unsigned int j = 0; j < mesh->mNumFaces; ++j) {
-      const aiFace& face {mesh->mFaces[j]};
-      indices.emplace_back(face.mIndices[0]);
-      indices.emplace_back(face.mIndices[1]);
-      indices.emplace_back(face.mIndices[2]);
-      first_index += 3;
+    const glm::vec3 cell {glm::floor((min_point + max_point) / (2.0f * options_.merge_cell_size))};
+    const std::tuple key {mesh->mMaterialIndex,
+                          static_cast<int>(cell.x),
+                          static_cast<int>(cell.y),
+                          static_cast<int>(cell.z)};
+    const auto [it, inserted] {batch_indices.try_emplace(key, batches.size())};
+    if (inserted) batches.emplace_back();
+    batches[it->second].push_back(mesh);
+  }
+
+  if (options_.merge_cell_size > 0.0f) {
+    std::cout << std::format("INFO (Model::batchMeshes): Merged {} meshes into {} draw commands.",
+                             num_batched_meshes,
+                             batches.size())
+              << std::endl;
+  }
+  return batches;
+}
+
+void Model::encodeVertexAndIndexData(const std::vector<Vertex>& vertices,
+                                     const std::vector<GLuint>& indices,
+                                     std::vector<DrawElementsIndirectCommand>& draw_commands,
+                                     std::vector<DrawLod>& draw_lods,
+                                     GeometryData& geometry) const {
+  if (!options_.compressed_vertices) {
+    appendBytes(geometry.vertex_data, std::as_bytes(std::span {vertices}));
+    appendBytes(geometry.index_data, std::as_bytes(std::span {indices}));
+    return;
+  }
+
+  /// Quantize positions to a grid spanning the model's bounding box
+  glm::vec3 min_point {std::numeric_limits<float>::max()};
+  glm::vec3 max_point {std::numeric_limits<float>::lowest()};
+  for (const Vertex& vertex : vertices) {
+    const glm::vec3 position {vertex.position[0], vertex.position[1], vertex.position[2]};
+    min_point = glm::min(min_point, position);
+    max_point = glm::max(max_point, position);
+  }
+  constexpr GLuint max_quantized {(1u << POSITION_QUANTIZATION_BITS) - 1};
+  const glm::vec3 step {glm::max((max_point - min_point) / static_cast<float>(max_quantized), glm::vec3(1e-7f))};
+  const PackedVertexHeader header {glm::vec4(min_point, 0.0f), glm::vec4(step, 0.0f)};
+  std::vector<PackedVertex> packed_vertices;
+  packed_vertices.reserve(vertices.size());
+  for (const Vertex& vertex : vertices) {
+    const glm::vec3 position {vertex.position[0], vertex.position[1], vertex.position[2]};
+    const glm::vec3 quantized {glm::clamp(glm::floor((position - min_point) / step + 0.5f),
+                                          glm::vec3(0.0f),
+                                          glm::vec3(static_cast<float>(max_quantized)))};
+    const auto x {static_cast<GLuint>(quantized.x)};
+    const auto y {static_cast<GLuint>(quantized.y)};
+    const auto z {static_cast<GLuint>(quantized.z)};
+    packed_vertices.push_back({{x | y << POSITION_QUANTIZATION_BITS,
+                                y >> (32 - POSITION_QUANTIZATION_BITS) | z << (2 * POSITION_QUANTIZATION_BITS - 32)},
+                               encodeOctahedral(vertex.tangent),
+                               encodeOctahedral(vertex.bitangent),
+                               glm::packHalf2x16(glm::vec2(vertex.uv[0], vertex.uv[1]))});
+  }
+  appendBytes(geometry.vertex_data, std::as_bytes(std::span {&header, 1}));
+  appendBytes(geometry.vertex_data, std::as_bytes(std::span {packed_vertices}));
+
+  /// Indices fit in 16 bits if every draw references fewer than 2^16 vertices. Move the base vertex of each draw to its
+  /// lowest referenced vertex, so that only the vertex range of the draw itself matters. Levels of detail only use
+  /// vertices of the full detail draw, so the same offset applies to them.
+  const auto getIndexRange {[&indices](const DrawElementsIndirectCommand& command) {
+    const auto first {indices.begin() + command.first_vertex};
+    return command.count > 0 ? std::minmax_element(first, first + command.count) : std::pair {first, first};
+  }};
+  const bool fits_short_indices {std::ranges::all_of(draw_commands, [&](const DrawElementsIndirectCommand& command) {
+    const auto [min_index, max_index] {getIndexRange(command)};
+    return command.count == 0 || *max_index - *min_index <= std::numeric_limits<GLushort>::max();
+  })};
+  if (fits_short_indices) {
+    std::vector<GLushort> short_indices(indices.size());
+    for (size_t draw = 0; draw < draw_commands.size(); ++draw) {
+      DrawElementsIndirectCommand& command {draw_commands[draw]};
+      const GLuint offset {command.count > 0 ? *getIndexRange(command).first : 0};
+      const DrawLod& lod {draw_lods[draw]};
+      for (GLuint level = 0; level < lod.num_levels; ++level) {
+        for (GLuint i = lod.first_index[level]; i < lod.first_index[level] + lod.count[level]; ++i) {
+          short_indices[i] = static_cast<GLushort>(indices[i] - offset);
+        }
+      }
+      command.base_vertex += static_cast<GLint>(offset);
     }
+    geometry.index_type = GL_UNSIGNED_SHORT;
+    appendBytes(geometry.index_data, std::as_bytes(std::span {short_indices}));
+  } else {
+    appendBytes(geometry.index_data, std::as_bytes(std::span {indices}));
   }
-  num_draw_commands_ = static_cast<GLsizei>(std::ssize(draw_commands));
-  createBufferFromVector(vertex_buffer_, vertices);
-  createBufferFromVector(index_buffer_, indices);
-  createBufferFromVector(draw_command_buffer_, draw_commands);
-  glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
-                       GL_DEBUG_TYPE_OTHER,
-                       0,
-                       GL_DEBUG_SEVERITY_NOTIFICATION,
-                       -1,
-                       "(Model::createBuffers): Completed successfully.");
+
+  const size_t old_size {vertices.size() * sizeof(Vertex) + indices.size() * sizeof(GLuint)};
+  const size_t new_size {geometry.vertex_data.size() + geometry.index_data.size()};
+  std::cout << std::format("INFO (Model::encodeVertexAndIndexData): Compressed vertex and index data from {} KiB "
+                           "to {} KiB ({}-bit indices).",
+                           old_size >> 10,
+                           new_size >> 10,
+                           geometry.index_type == GL_UNSIGNED_SHORT ? 16 : 32)
+            << std::endl;
+}
+
+GLuint Model::encodeOctahedral(const GLfloat (&vector)[3]) {
+  /// Project onto the octahedron |x|+|y|+|z| = 1, and fold the lower half over the upper one
+  glm::vec3 v {vector[0], vector[1], vector[2]};
+  v /= glm::max(std::abs(v.x) + std::abs(v.y) + std::abs(v.z), 1e-20f);
+  glm::vec2 encoded {v.x, v.y};
+  if (v.z < 0.0f) {
+    encoded = glm::vec2((1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+                        (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+  }
+  return glm::packSnorm2x16(encoded);
 }
 
-void Model::createBufferFromVector(wrap::Buffer& buffer, const std::vector<auto>& vector) {
+void Model::createBufferFromData(wrap::Buffer& buffer, const std::span<const std::byte> data) {
   glCreateBuffers(1, &buffer.id);
-  glNamedBufferStorage(buffer.id, sizeof(decltype(*vector.begin())) * std::ssize(vector), vector.data(), GL_DYNAMIC_STORAGE_BIT);
+  glNamedBufferStorage(buffer.id, static_cast<GLsizeiptr>(data.size()), data.data(), GL_DYNAMIC_STORAGE_BIT);
+}
+
+void Model::appendBytes(std::vector<std::byte>& bytes, const std::span<const std::byte> data) {
+  bytes.insert(bytes.end(), data.begin(), data.end());
 }
 
 void Model::checkAssimpSceneErrors(const aiScene* scene, const std::string& path) const {
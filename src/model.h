@@ -3,6 +3,8 @@
 
 #include "opengl_wrappers.h"
 #include "shader_program.h"
+#include "file_helpers.h"
+#include "texture_compression_helpers.h"
 
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
@@ -11,12 +13,73 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <span>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <functional>
 
 /**
  * Implements everything needed to draw a model, using Multi-Draw Indirect and a uniform array for textures.
  */
 class Model {
 public:
+  /**
+   * Optional processing steps applied while loading. All of them are disabled when value-initialized.
+   */
+  struct LoadOptions {
+    /**
+     * If positive, meshes that share a material and whose bounding box centers fall in the same cubic cell of this
+     * edge length are merged into a single draw command. The cells keep the merged draws small enough to be culled.
+     */
+    float merge_cell_size;
+    /**
+     * If positive, every draw is split into meshlets of at most this many triangles, each with its own draw command.
+     * Meshlets grow across shared vertices and never take a triangle facing away from their average normal, so that
+     * they stay compact and their normal cones narrow. The cull shaders merge surviving neighbours back into one
+     * command.
+     */
+    GLuint meshlet_max_triangles;
+    /**
+     * If true, vertices are stored as PackedVertex (see below) instead of Vertex, and indices are stored as 16-bit
+     * values relative to the base vertex of each draw whenever every draw allows it.
+     */
+    bool compressed_vertices;
+    /**
+     * If true, identical vertices are welded, the triangles of every draw are reordered for the post-transform vertex
+     * cache, and the vertices of every batch are reordered for sequential fetching. Cache statistics are printed.
+     */
+    bool optimize_geometry;
+    /**
+     * Number of simplified levels of detail built for every draw (at most MAX_LOD_LEVELS - 1). Level i targets 1/2^i of
+     * the triangles of the full detail draw. Levels that would remove less than 10% of the previous one are skipped.
+     */
+    GLuint lod_levels;
+    /**
+     * If true, the processed buffers, draw commands, material names and light positions are written to a binary
+     * cache file (CACHE_FILE_NAME in the model folder) after loading. Later runs map that file into memory and pass it
+     * straight to OpenGL, skipping Assimp and all of the steps above. The cache is rebuilt whenever model.obj or
+     * lights.obj change (size or modification time), or when any of the other options differ.
+     */
+    bool use_cache;
+    /**
+     * If true, textures are baked on the CPU to KTX2 files next to their PNGs (when missing or older than the PNG),
+     * and loaded from there without decoding: diffuse as BC1, normal as BC5 (x and y only), specular as BC4.
+     */
+    bool compressed_textures;
+    /**
+     * Maximum anisotropy used when sampling the material textures (clamped to what the implementation supports).
+     * Values of 1 or less select plain trilinear filtering.
+     */
+    GLfloat max_anisotropy;
+    /**
+     * If true, materials use two texture arrays instead of three: diffuse RGB with specular in alpha, and the x and y
+     * of the normal (z is reconstructed). Saves a third of the layers, and a texture fetch per fragment.
+     */
+    bool packed_materials;
+  };
+
   std::vector<glm::vec4> light_positions_;
 
   /**
@@ -28,36 +91,101 @@ public:
    * <folder_path>/specular/<mtl-name>.png.
    * <p>
    * The textures should be 128x128, in RGB or RGBA format (4th channel will be ignored). Missing textures will be
-   * replaced by DefaultMaterial.png (if available), but bad textures may result in unexpected behaviour.
+   * replaced by DefaultMaterial.png (if available), but bad textures may result in unexpected behaviour. Normal maps
+   * should hold unit length normals, since their z component is reconstructed when compressed_textures or
+   * packed_materials is set.
    * <p>
    * Lighting information may be provided in a second .obj file. Each face of each mesh using material "light_source"
    * will be interpreted as a point light (by averaging the vertices). All other meshes will be ignored.
    *
    * @param folder_path Path to a folder (global, or relative to executable) containing a model.obj file, the texture
    *                    folders, and optionally a lights.obj file as described above.
+   * @param options     See LoadOptions.
+   * @param report_progress Called with the fraction of the loading work completed so far (from 0 to 1), on the thread
+   *                        constructing the Model. That thread must have a current OpenGL context.
    */
-  explicit Model(std::string folder_path);
+  explicit Model(std::string folder_path,
+                 LoadOptions options = {},
+                 std::function<void(float)> report_progress = {});
 
   /**
-   * Binds GL_DRAW_INDIRECT_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_SHADER_STORAGE_BUFFER at vertex_buffer_binging.
-   * Binds texture_array_ to the texture unit specified by texture_binding.
+   * Binds GL_DRAW_INDIRECT_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_SHADER_STORAGE_BUFFER at vertex_buffer_binding.
+   * Binds the diffuse, normal and specular texture arrays to the texture units specified by the other bindings.
    */
-  void drawSetup(GLuint vertex_buffer_binding, GLuint texture_binding) const;
+  void drawSetup(GLuint vertex_buffer_binding,
+                 GLuint diffuse_binding,
+                 GLuint normal_binding,
+                 GLuint specular_binding) const;
 
   /**
    * Draws the model. drawSetup() must have been called at least once before this method.
    *
    * @param shader  Should read vertex data from an SSBO containing an array of Vertex structs matching the definition
-   *                below. May define a sampler2DArray uniform. Bindings should equal the ones passed to drawSetup().
+   *                below, or with compressed_vertices, a PackedVertexHeader followed by an array of PackedVertex
+   *                structs. May define sampler2DArray uniforms. Bindings should equal the ones passed to drawSetup().
    *                The vertex and material indices will be available as gl_VertexID and gl_BaseInstance respectively.
-   *                The diffuse texture for a given material is layer gl_BaseInstance*3 of the texture array
-   *                (normal is *3+1, specular is *3+2).
+   *                The textures for a given material are layer gl_BaseInstance of each texture array. With
+   *                compressed_textures or packed_materials, the normal array only holds x and y. With
+   *                packed_materials, specular is stored in the alpha channel of the diffuse array, and no specular
+   *                array is bound.
    */
   void draw(const std::unique_ptr<ShaderProgram>& shader) const {
     shader->use();
-    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, num_draw_commands_, 0);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, index_type_, nullptr, num_draw_commands_, 0);
   }
 
+  /**
+   * Binds the per-draw bounding boxes, the per-draw bounding spheres and normal cones, the per-draw levels of detail,
+   * the full draw command list, and the per-draw visibility flags as SSBOs at the given bindings. The remaining two
+   * bindings are used by cull() for the command list and draw count it writes to.
+   * <p>
+   * The visibility flags (one uint per draw command, initially 0) are never written by the Model itself. They persist
+   * between frames, so that cull shaders can use them to remember which draws were visible last frame.
+   */
+  void cullSetup(GLuint bounds_binding,
+                 GLuint cone_binding,
+                 GLuint lod_binding,
+                 GLuint command_binding,
+                 GLuint culled_command_binding,
+                 GLuint draw_count_binding,
+                 GLuint visibility_binding);
+
+  /**
+   * Creates an additional list that cull() can write to. List 0 always exists, and holds up to one command per draw.
+   *
+   * @param max_commands_per_draw   Upper bound on the number of commands a cull shader may emit per source command.
+   *
+   * @returns   The index of the new list.
+   */
+  size_t createCulledDrawList(GLsizei max_commands_per_draw);
+
+  /**
+   * Resets the draw count of the given list, binds it, and dispatches one shader invocation per draw command.
+   * cullSetup() must have been called at least once before this method.
+   *
+   * @param shader  Should be a compute shader with a local size of CULL_GROUP_SIZE, which reads DrawBounds and
+   *                DrawElementsIndirectCommand structs matching the definitions below, and appends the commands that
+   *                pass its visibility test to the culled list (using an atomic increment of the draw count).
+   */
+  void cull(const std::unique_ptr<ShaderProgram>& shader, size_t list_index = 0) const;
+
+  /**
+   * Same as draw(), but only draws the commands written by the most recent cull() call to the given list.
+   */
+  void drawCulled(const std::unique_ptr<ShaderProgram>& shader, const size_t list_index = 0) const {
+    const CulledDrawList& list {*culled_draw_lists_[list_index]};
+    shader->use();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, list.command_buffer.id);
+    glBindBuffer(GL_PARAMETER_BUFFER, list.count_buffer.id);
+    glMultiDrawElementsIndirectCount(GL_TRIANGLES, index_type_, nullptr, 0, list.max_draw_count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw_command_buffer_.id);
+  }
+
+  [[nodiscard]] GLsizei getNumDrawCommands() const { return num_draw_commands_; }
+
+  static constexpr GLuint CULL_GROUP_SIZE {64};
+  static constexpr GLuint MAX_LOD_LEVELS {4}; // including full detail
+
 private:
   struct Vertex {
     GLfloat position[3];
@@ -65,6 +193,16 @@ private:
     GLfloat bitangent[3];
     GLfloat uv[2];
   };
+  struct PackedVertexHeader {
+    glm::vec4 position_min;  // model space AABB minimum
+    glm::vec4 position_step; // size of one quantization step along each axis
+  };
+  struct PackedVertex {
+    GLuint position[2]; // 21 bits per axis, in steps from position_min
+    GLuint tangent;     // octahedral encoding, as two snorm16 values
+    GLuint bitangent;   // octahedral encoding, as two snorm16 values
+    GLuint uv;          // two half floats
+  };
   struct DrawElementsIndirectCommand {
     GLuint count;
     GLuint instance_count;
@@ -72,23 +210,140 @@ private:
     GLint base_vertex;
     GLuint base_instance; // We don't use instancing, so this is re-purposed as material index of the mesh
   };
+  struct DrawBounds {
+    glm::vec4 min_point; // world space AABB of the geometry referenced by the matching draw command
+    glm::vec4 max_point;
+  };
+  struct DrawCone {
+    glm::vec4 sphere; // bounding sphere (center, radius)
+    glm::vec4 cone;   // normal cone (axis, cutoff). All triangles face away from viewers for which
+                      // dot(center - viewer, axis) >= cutoff * |center - viewer| + radius. A cutoff of 1 never culls.
+  };
+  struct DrawLod {
+    GLuint num_levels;
+    GLuint first_index[MAX_LOD_LEVELS]; // level 0 matches the draw command
+    GLuint count[MAX_LOD_LEVELS];
+    GLfloat error[MAX_LOD_LEVELS];      // geometric error of each level, in world units
+  };
+  /**
+   * Owns the processed model data until it is uploaded (and cached).
+   */
+  struct GeometryData {
+    std::vector<std::byte> vertex_data; // array of Vertex, or PackedVertexHeader + array of PackedVertex
+    std::vector<std::byte> index_data;
+    GLenum index_type {GL_UNSIGNED_INT};
+    std::vector<DrawElementsIndirectCommand> draw_commands;
+    std::vector<DrawBounds> draw_bounds;
+    std::vector<DrawCone> draw_cones;
+    std::vector<DrawLod> draw_lods;
+  };
+  /**
+   * Refers to processed model data, either in a GeometryData or in a memory-mapped cache file.
+   */
+  struct GeometryView {
+    std::span<const std::byte> vertex_data;
+    std::span<const std::byte> index_data;
+    GLenum index_type;
+    std::span<const DrawElementsIndirectCommand> draw_commands;
+    std::span<const DrawBounds> draw_bounds;
+    std::span<const DrawCone> draw_cones;
+    std::span<const DrawLod> draw_lods;
+  };
+  enum CacheSection {
+    VERTEX, INDEX, DRAW_COMMAND, DRAW_BOUNDS, DRAW_CONE, DRAW_LOD, LIGHT_POSITION, MATERIAL_NAME, NUM_CACHE_SECTIONS
+  };
+  /**
+   * Everything a cache file depends on. A cache is only used if its key equals the current one.
+   */
+  struct CacheKey {
+    std::uint32_t magic;
+    std::uint32_t version;
+    help::FileStamp model_stamp;
+    help::FileStamp lights_stamp;
+    GLfloat merge_cell_size;
+    GLuint meshlet_max_triangles;
+    GLuint compressed_vertices;
+    GLuint optimize_geometry;
+    GLuint lod_levels;
+    bool operator==(const CacheKey&) const = default;
+  };
+  struct CacheHeader {
+    CacheKey key;
+    GLenum index_type;
+    std::uint64_t section_offset[NUM_CACHE_SECTIONS]; // in bytes from the start of the file
+    std::uint64_t section_size[NUM_CACHE_SECTIONS];   // in bytes
+  };
+  struct CulledDrawList {
+    wrap::Buffer command_buffer;
+    wrap::Buffer count_buffer;
+    GLsizei max_draw_count;
+  };
 
   Assimp::Importer importer_ {};
   std::string source_dir_;
+  LoadOptions options_;
+  std::function<void(float)> report_progress_;
   GLsizei num_draw_commands_ {};
+  GLenum index_type_ {GL_UNSIGNED_INT};
 
   wrap::Buffer vertex_buffer_ {};
   wrap::Buffer index_buffer_ {};
   wrap::Buffer draw_command_buffer_ {};
-  wrap::Texture texture_array_ {};
+  wrap::Buffer draw_bounds_buffer_ {};
+  wrap::Buffer draw_cone_buffer_ {};
+  wrap::Buffer draw_lod_buffer_ {};
+  wrap::Buffer draw_visibility_buffer_ {};
+  std::vector<std::unique_ptr<CulledDrawList>> culled_draw_lists_;
+  GLuint culled_command_binding_ {};
+  GLuint draw_count_binding_ {};
+  wrap::Texture diffuse_array_ {};
+  wrap::Texture normal_array_ {};
+  wrap::Texture specular_array_ {};
 
   void loadModelData();
   void loadLightData();
-  void createTextureArray(aiMaterial** materials, unsigned int num_materials);
-  void createBuffers(aiMesh** meshes, unsigned int num_meshes);
-  static void createBufferFromVector(wrap::Buffer& buffer, const std::vector<auto>& vector);
+  bool loadCache();
+  void writeCache(const GeometryView& geometry, std::span<const std::string> material_names) const;
+  [[nodiscard]] CacheKey getCacheKey() const;
+  void createTextureArrays(std::span<const std::string> material_names);
+  void createTextureArray(wrap::Texture& texture,
+                          const std::string& folder,
+                          const std::string& alpha_folder,
+                          std::span<const std::string> material_names,
+                          GLenum internal_format,
+                          help::BlockFormat compressed_format,
+                          help::MipFilter mip_filter) const;
+  [[nodiscard]] std::string getTexturePath(const std::string& folder, const std::string& material_name) const;
+  [[nodiscard]] GeometryData createGeometry(aiMesh** meshes, unsigned int num_meshes);
+  void createBuffers(const GeometryView& geometry);
+  [[nodiscard]] std::vector<std::vector<const aiMesh*>> batchMeshes(aiMesh** meshes, unsigned int num_meshes) const;
+  [[nodiscard]] std::vector<std::vector<GLuint>> buildMeshlets(std::span<const Vertex> vertices,
+                                                               const std::vector<GLuint>& indices) const;
+  [[nodiscard]] static std::pair<DrawBounds, DrawCone> computeDrawBounds(std::span<const Vertex> vertices,
+                                                                         const std::vector<GLuint>& indices);
+  void appendLods(std::span<const glm::vec3> positions,
+                  const std::vector<GLuint>& draw_indices,
+                  DrawLod& lod,
+                  std::vector<GLuint>& indices) const;
+  [[nodiscard]] static glm::vec3 getTriangleNormal(std::span<const Vertex> vertices, GLuint a, GLuint b, GLuint c);
+  void encodeVertexAndIndexData(const std::vector<Vertex>& vertices,
+                                const std::vector<GLuint>& indices,
+                                std::vector<DrawElementsIndirectCommand>& draw_commands,
+                                std::vector<DrawLod>& draw_lods,
+                                GeometryData& geometry) const;
+  [[nodiscard]] static GLuint encodeOctahedral(const GLfloat (&vector)[3]);
+  static void createBufferFromData(wrap::Buffer& buffer, std::span<const std::byte> data);
+  static void appendBytes(std::vector<std::byte>& bytes, std::span<const std::byte> data);
   void checkAssimpSceneErrors(const aiScene* scene, const std::string& path) const;
+  void reportProgress(const float fraction) const { if (report_progress_) report_progress_(fraction); }
 
   static constexpr GLsizei TEX_SIZE {128};
+  static constexpr GLsizei TEX_NUM_LEVELS {std::bit_width(static_cast<unsigned>(TEX_SIZE))}; // full mip chain
+  static constexpr GLuint POSITION_QUANTIZATION_BITS {21};
+  static constexpr GLuint VERTEX_CACHE_SIZE {16}; // conservative, so that the ordering works on most hardware
+  static constexpr auto CACHE_FILE_NAME {"model.cache"};
+  static constexpr std::uint32_t CACHE_MAGIC {0x4C474D54}; // "TMGL"
+  static constexpr std::uint32_t CACHE_VERSION {2};        // increment whenever cached data changes layout or content
+  static constexpr size_t CACHE_SECTION_ALIGNMENT {64};
 };
 #endif //TEMPLEGL_SRC_MODEL_H_
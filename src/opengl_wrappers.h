@@ -72,5 +72,17 @@ namespace wrap {
       glDeleteRenderbuffers(1, &id);
     }
   };
+  struct Query {
+    GLuint id;
+    ~Query() {
+      glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                           GL_DEBUG_TYPE_OTHER,
+                           id,
+                           GL_DEBUG_SEVERITY_MEDIUM,
+                           -1,
+                           "Deleting Query");
+      glDeleteQueries(1, &id);
+    }
+  };
 }
 #endif //TEMPLEGL_SRC_OPENGL_WRAPPERS_H_
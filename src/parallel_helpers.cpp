@@ -0,0 +1,26 @@
+#include "parallel_helpers.h"
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+void help::parallelFor(const size_t count, const std::function<void(size_t)>& function) {
+  PROFILE_ZONE("help::parallelFor");
+  if (count == 0) return;
+  std::atomic<size_t> next_index {0};
+  const auto work {[&] {
+    for (size_t i = next_index++; i < count; i = next_index++) { function(i); }
+  }};
+  const size_t num_workers {std::clamp<size_t>(std::thread::hardware_concurrency(), 1, count)};
+  std::vector<std::jthread> workers;
+  workers.reserve(num_workers - 1);
+  for (size_t i = 1; i < num_workers; ++i) {
+    workers.emplace_back([&] {
+      PROFILE_THREAD_NAME("parallelFor worker");
+      work();
+    });
+  }
+  work();
+}
@@ -0,0 +1,20 @@
+#ifndef TEMPLEGL_SRC_PARALLEL_HELPERS_H_
+#define TEMPLEGL_SRC_PARALLEL_HELPERS_H_
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * Collects helper functions for spreading CPU work over multiple threads.
+ */
+namespace help {
+  /**
+   * Calls function(i) for every i in [0, count), on a pool of worker threads (one per hardware thread, at most one per
+   * index). The calling thread takes part, and only returns when every call has finished. Indices are handed out one
+   * at a time, so calls of uneven length are balanced automatically.
+   * <p>
+   * The function must not call OpenGL, since the worker threads have no context.
+   */
+  void parallelFor(size_t count, const std::function<void(size_t)>& function);
+}
+#endif //TEMPLEGL_SRC_PARALLEL_HELPERS_H_
@@ -1,4 +1,6 @@
 #include "renderer.h"
+#include "cpu_profiler.h"
+#include "json_helpers.h"
 
 #include <yaml-cpp/yaml.h>
 #include <yaml-cpp/exceptions.h>
@@ -6,8 +8,25 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <format>
+#include <bit>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+/**
+ * @param a, b    Texel rectangles (x, y, end x, end y), where end x <= x means empty.
+ *
+ * @returns   The smallest rectangle containing both.
+ */
+static glm::ivec4 uniteRegions(const glm::ivec4& a, const glm::ivec4& b) {
+  if (a.x >= a.z) return b;
+  if (b.x >= b.z) return a;
+  return {glm::min(a.x, b.x), glm::min(a.y, b.y), glm::max(a.z, b.z), glm::max(a.w, b.w)};
+}
 
 void Renderer::loadConfigYaml() {
   Initializer::loadConfigYaml();
@@ -37,8 +56,138 @@ void Renderer::loadConfigYaml() {
     config_.camera_near_plane            = config_yaml["camera"]["view_frustum"]["near_plane"].as<float>();
     config_.camera_far_plane             = config_yaml["camera"]["view_frustum"]["far_plane"].as<float>();
     config_.model_source_path            = config_yaml["model"]["source_path"].as<std::string>();
+    config_.model_load_options.merge_cell_size = config_yaml["model"]["merge_cell_size"].as<float>();
     config_.shader_source_path           = config_yaml["shader"]["source_path"].as<std::string>();
     config_.debug_render_light_positions = config_yaml["debug"]["render_light_positions"].as<bool>();
+    config_.clustered_shading            = config_yaml["lighting"]["clustered_shading"].as<bool>();
+    config_.frustum_culling              = config_yaml["culling"]["frustum"].as<bool>();
+    config_.occlusion_culling            = config_yaml["culling"]["occlusion"].as<bool>();
+    config_.cone_culling                 = config_yaml["culling"]["cone"].as<bool>();
+    config_.small_draw_culling           = config_yaml["culling"]["small_draws"].as<bool>();
+    config_.lod_pixel_error              = config_yaml["culling"]["lod_pixel_error"].as<float>();
+    config_.model_load_options.lod_levels = config_yaml["model"]["lod_levels"].as<GLuint>();
+    config_.model_load_options.meshlet_max_triangles = config_yaml["model"]["meshlet_max_triangles"].as<GLuint>();
+    config_.model_load_options.compressed_vertices   = config_yaml["model"]["compressed_vertices"].as<bool>();
+    config_.model_load_options.optimize_geometry     = config_yaml["model"]["optimize_geometry"].as<bool>();
+    config_.model_load_options.use_cache             = config_yaml["model"]["cache"].as<bool>();
+    config_.model_load_options.compressed_textures   = config_yaml["model"]["compressed_textures"].as<bool>();
+    config_.model_load_options.max_anisotropy        = config_yaml["model"]["max_anisotropy"].as<float>();
+    config_.model_load_options.packed_materials      = config_yaml["model"]["packed_materials"].as<bool>();
+    config_.async_model_loading                      = config_yaml["model"]["async_loading"].as<bool>();
+    config_.shadow_cache                 = config_yaml["shadows"]["cache"].as<bool>();
+    config_.shadow_cache_padding         = config_yaml["shadows"]["cache_padding"].as<float>();
+    config_.shadow_update_intervals      = config_yaml["shadows"]["update_intervals"].as<std::vector<GLuint>>();
+    if (config_.shadow_update_intervals.size() != CSM_NUM_CASCADES) {
+      std::cerr << "WARNING (Renderer::loadConfigYaml): invalid setting in config.yaml, "
+                << "shadows.update_intervals must be an array of exactly " << CSM_NUM_CASCADES << " integers. "
+                << "Defaulting to updating every cascade whenever needed." << std::endl;
+      config_.shadow_update_intervals.assign(CSM_NUM_CASCADES, 1);
+    }
+    config_.shadow_resolution            = config_yaml["shadows"]["resolution"].as<GLsizei>();
+    config_.shadow_resident_resolution   = config_yaml["shadows"]["resident_resolution"].as<GLsizei>();
+    if (const auto depth_format_str {config_yaml["shadows"]["depth_format"].as<std::string>()};
+        depth_format_str == "d16") {
+      config_.shadow_depth_format = GL_DEPTH_COMPONENT16;
+    } else if (depth_format_str == "d24") {
+      config_.shadow_depth_format = GL_DEPTH_COMPONENT24;
+    } else if (depth_format_str == "d32f") {
+      config_.shadow_depth_format = GL_DEPTH_COMPONENT32F;
+    } else {
+      std::cerr << "WARNING (Renderer::loadConfigYaml): invalid setting in config.yaml, "
+                << "shadows.depth_format must be one of 'd16', 'd24', 'd32f'. Defaulting to 'd32f'." << std::endl;
+      config_.shadow_depth_format = GL_DEPTH_COMPONENT32F;
+    }
+    config_.sparse_shadows               = config_yaml["shadows"]["sparse"].as<bool>();
+    config_.sdsm                         = config_yaml["shadows"]["sdsm"].as<bool>();
+    config_.report_statistics            = config_yaml["debug"]["report_statistics"].as<bool>();
+    config_.profile_gpu                  = config_yaml["debug"]["profile_gpu"].as<bool>();
+    config_.profile_gpu_csv_path         = config_yaml["debug"]["profile_gpu_csv"].as<std::string>();
+
+    for (const auto& path_yaml : config_yaml["camera"]["paths"]) {
+      const auto name {path_yaml.first.as<std::string>()};
+      std::vector<CameraPath::Keyframe> keyframes;
+      for (const auto& keyframe : path_yaml.second.as<std::vector<std::vector<float>>>()) {
+        if (keyframe.size() != 6 || (!keyframes.empty() && keyframe[0] <= keyframes.back().time)) {
+          std::cerr << "WARNING (Renderer::loadConfigYaml): invalid setting in config.yaml, camera.paths." << name
+                    << " entries must be arrays of exactly 6 floats, with increasing times. Skipping an entry."
+                    << std::endl;
+          continue;
+        }
+        keyframes.push_back({keyframe[0],
+                             {glm::vec3(keyframe[1], keyframe[2], keyframe[3]),
+                              glm::radians(keyframe[4]),
+                              glm::radians(keyframe[5])}});
+      }
+      if (keyframes.empty()) {
+        std::cerr << "WARNING (Renderer::loadConfigYaml): invalid setting in config.yaml, camera.paths." << name
+                  << " has no valid keyframes. Skipping the path." << std::endl;
+        continue;
+      }
+      config_.camera_paths.emplace(name, std::move(keyframes));
+    }
+
+    const YAML::Node& benchmark_yaml {config_yaml["benchmark"]};
+    config_.benchmark_path          = benchmark_yaml["path"].as<std::string>();
+    config_.benchmark_warmup_frames = std::max(benchmark_yaml["warmup_frames"].as<GLuint>(), 1u);
+    config_.benchmark_output_path   = benchmark_yaml["output_path"].as<std::string>();
+    if (run_mode_ == BENCHMARK) {
+      // The frame timings must only be reset by the benchmark
+      config_.report_statistics = false;
+    }
+
+    const YAML::Node& golden_yaml {config_yaml["golden"]};
+    for (const auto& view_yaml : golden_yaml["views"]) {
+      const auto name {view_yaml.first.as<std::string>()};
+      if (const auto pose {view_yaml.second.as<std::vector<float>>()}; pose.size() == 5) {
+        config_.golden_views.push_back({name,
+                                        {glm::vec3(pose[0], pose[1], pose[2]),
+                                         glm::radians(pose[3]),
+                                         glm::radians(pose[4])}});
+      } else {
+        std::cerr << "WARNING (Renderer::loadConfigYaml): invalid setting in config.yaml, golden.views." << name
+                  << " must be an array of exactly 5 floats. Skipping the view." << std::endl;
+      }
+    }
+    config_.golden_frames_per_view     = std::max(golden_yaml["frames_per_view"].as<GLuint>(), 2u);
+    config_.golden_directory           = golden_yaml["directory"].as<std::string>();
+    config_.golden_thresholds.min_psnr = golden_yaml["min_psnr"].as<double>();
+    config_.golden_thresholds.min_ssim = golden_yaml["min_ssim"].as<double>();
+    config_.golden_output_path         = golden_yaml["output_path"].as<std::string>();
+    config_.golden_allow_missing       = golden_yaml["allow_missing"].as<bool>();
+    if (run_mode_ == GOLDEN_TEST || run_mode_ == GOLDEN_UPDATE) {
+      // Golden images are rendered at a fixed resolution, which may differ from the window size
+      if (const auto resolution {golden_yaml["resolution"].as<std::vector<int>>()}; resolution.size() == 2) {
+        config_.window_width  = resolution[0];
+        config_.window_height = resolution[1];
+      } else {
+        std::cerr << "WARNING (Renderer::loadConfigYaml): invalid setting in config.yaml, "
+                  << "golden.resolution must be an array of exactly 2 integers. Defaulting to the window size."
+                  << std::endl;
+      }
+    }
+
+    if (run_mode_ == BENCHMARK || run_mode_ == GOLDEN_TEST || run_mode_ == GOLDEN_UPDATE) {
+      config_.headless = config_yaml["headless"]["enabled"].as<bool>();
+      if (const auto context_api_str {config_yaml["headless"]["context_api"].as<std::string>()};
+          context_api_str == "egl") {
+        config_.headless_context_api = GLFW_EGL_CONTEXT_API;
+      } else if (context_api_str == "osmesa") {
+        config_.headless_context_api = GLFW_OSMESA_CONTEXT_API;
+      } else {
+        std::cerr << "WARNING (Renderer::loadConfigYaml): invalid setting in config.yaml, "
+                  << "headless.context_api must be one of 'egl', 'osmesa'. Defaulting to 'egl'." << std::endl;
+        config_.headless_context_api = GLFW_EGL_CONTEXT_API;
+      }
+      // Headless runs often use software rendering, where full resolution shadow maps take far too long
+      if (const auto max_resolution {config_yaml["headless"]["shadow_resolution"].as<GLsizei>()};
+          config_.headless && config_.shadow_resolution > max_resolution) {
+        std::cout << "INFO (Renderer::loadConfigYaml): Capping shadows.resolution to headless.shadow_resolution ("
+                  << max_resolution << ")." << std::endl;
+        config_.shadow_resolution = max_resolution;
+      }
+    }
+    // Every frame of a scripted run should render the temple, for identical view sequences
+    if (run_mode_ != INTERACTIVE && run_mode_ != RECORD) config_.async_model_loading = false;
   } catch (YAML::Exception&) {
     std::cerr << "ERROR (Renderer::loadConfigYaml): Failed to parse config.yaml." << std::endl;
     throw; // re-throw to main
@@ -46,6 +195,7 @@ void Renderer::loadConfigYaml() {
 }
 
 void Renderer::renderSetup() {
+  PROFILE_ZONE("Renderer::renderSetup");
   // Bind a non-zero VAO to avoid errors, see https://www.khronos.org/opengl/wiki/Vertex_Rendering/Rendering_Failure
   glCreateVertexArrays(1, &objects_.vao.id);
   glBindVertexArray(objects_.vao.id);
@@ -56,6 +206,7 @@ void Renderer::renderSetup() {
 
   state_.first_time_receiving_mouse_input = true;
   state_.current_time                     = static_cast<float>(glfwGetTime());
+  state_.csm_cascades.resize(CSM_NUM_CASCADES);
   const auto aspect_ratio {static_cast<float>(config_.window_width) / static_cast<float>(config_.window_height)};
   camera_ = std::make_unique<Camera>(config_.initial_camera_pos,
                                      config_.initial_camera_yaw,
@@ -66,7 +217,28 @@ void Renderer::renderSetup() {
                                      aspect_ratio,
                                      config_.camera_near_plane,
                                      config_.camera_far_plane);
-  temple_model_ = std::make_unique<Model>(config_.model_source_path + "temple/");
+  if (run_mode_ == BENCHMARK) {
+    benchmark_ = std::make_unique<Benchmark>(getCameraPath(config_.benchmark_path), config_.benchmark_warmup_frames);
+  } else if (run_mode_ == REPLAY) {
+    camera_replay_ = std::make_unique<CameraPath>(getCameraPath(camera_path_));
+  } else if (run_mode_ == RECORD) {
+    camera_recorder_ = std::make_unique<CameraRecorder>(camera_path_);
+  } else if (run_mode_ == GOLDEN_TEST || run_mode_ == GOLDEN_UPDATE) {
+    if (config_.golden_views.empty()) {
+      throw std::runtime_error("ERROR (Renderer::renderSetup): golden.views in config.yaml holds no valid views.");
+    }
+    golden_test_ = std::make_unique<GoldenImageTest>(config_.golden_views,
+                                                     config_.golden_frames_per_view,
+                                                     config_.golden_directory,
+                                                     config_.golden_thresholds,
+                                                     config_.golden_allow_missing,
+                                                     run_mode_ == GOLDEN_UPDATE);
+  }
+  if (config_.async_model_loading) {
+    startModelLoad();
+  } else {
+    temple_model_ = std::make_unique<Model>(config_.model_source_path + "temple/", config_.model_load_options);
+  }
   const std::vector skybox_paths {
     config_.model_source_path + "skybox/px.png",
     config_.model_source_path + "skybox/nx.png",
@@ -75,37 +247,107 @@ void Renderer::renderSetup() {
     config_.model_source_path + "skybox/pz.png",
     config_.model_source_path + "skybox/nz.png"
   };
-  skybox_     = std::make_unique<Skybox>(skybox_paths);
-  csm_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, SHADER_CONSTANTS)
+  skybox_ = std::make_unique<Skybox>(skybox_paths, config_.model_load_options.compressed_textures);
+
+  if (config_.sparse_shadows && !querySparseShadowPageSize()) {
+    std::cerr << "WARNING (Renderer::renderSetup): ARB_sparse_texture is not supported for the chosen "
+              << "shadows.depth_format. Defaulting to fully resident shadow maps." << std::endl;
+    config_.sparse_shadows = false;
+  }
+  clampShadowResolution();
+
+  // Settings that change shader code paths are passed alongside the binding constants
+  shader_constants_ = SHADER_CONSTANTS;
+  shader_constants_.emplace_back("CLUSTERED_SHADING", config_.clustered_shading);
+  shader_constants_.emplace_back("FRUSTUM_CULLING", config_.frustum_culling || config_.occlusion_culling);
+  shader_constants_.emplace_back("CONE_CULLING", config_.cone_culling);
+  shader_constants_.emplace_back("SMALL_DRAW_CULLING", config_.small_draw_culling);
+  shader_constants_.emplace_back("COMPRESSED_VERTICES", config_.model_load_options.compressed_vertices);
+  shader_constants_.emplace_back("COMPRESSED_TEXTURES", config_.model_load_options.compressed_textures);
+  shader_constants_.emplace_back("PACKED_MATERIALS", config_.model_load_options.packed_materials);
+  shader_constants_.emplace_back("LOD_SELECTION", config_.model_load_options.lod_levels > 0);
+  shader_constants_.emplace_back("SPARSE_SHADOWS", config_.sparse_shadows);
+  csm_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, shader_constants_)
                                                 .vertex("csm.vert")
-                                                .geometry("csm.geom")
                                                 .fragment("empty.frag"));
-  temple_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, SHADER_CONSTANTS)
+  csm_cull_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                           shader_constants_)
+                                                     .compute("csm_cull.comp"));
+  temple_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, shader_constants_)
                                                    .vertex("blinn_phong.vert")
                                                    .fragment("blinn_phong.frag"));
-  skybox_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, SHADER_CONSTANTS)
+  skybox_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, shader_constants_)
                                                    .vertex("sky.vert")
                                                    .fragment("sky.frag"));
-  image_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, SHADER_CONSTANTS)
+  image_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path, shader_constants_)
                                                   .vertex("image_space.vert")
                                                   .fragment("image_space.frag"));
   if (config_.debug_enabled && config_.debug_render_light_positions) {
     debug_light_positions_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(
                                                                      config_.shader_source_path,
-                                                                     SHADER_CONSTANTS)
+                                                                     shader_constants_)
                                                                     .vertex("debug_lights.vert")
                                                                     .geometry("debug_lights.geom")
                                                                     .fragment("debug_lights.frag"));
   }
+  if (config_.clustered_shading) {
+    cluster_bounds_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                   shader_constants_)
+                                                             .compute("cluster_bounds.comp"));
+    light_frustum_cull_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                       shader_constants_)
+                                                                 .compute("light_frustum_cull.comp"));
+    light_cluster_cull_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                       shader_constants_)
+                                                                 .compute("light_cluster_cull.comp"));
+  }
 
-  initializeMatrixBuffer();
-  initializeLightDataBuffer();
+  if (config_.frustum_culling) {
+    frustum_cull_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                 shader_constants_)
+                                                           .compute("frustum_cull.comp"));
+  }
+  if (config_.occlusion_culling) {
+    // Both phases share one source file, selected with a constant
+    auto early_phase_constants {shader_constants_};
+    auto late_phase_constants {shader_constants_};
+    early_phase_constants.emplace_back("OCCLUSION_CULL_LATE_PHASE", 0);
+    late_phase_constants.emplace_back("OCCLUSION_CULL_LATE_PHASE", 1);
+    occlusion_cull_early_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                         early_phase_constants)
+                                                                   .compute("occlusion_cull.comp"));
+    occlusion_cull_late_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                        late_phase_constants)
+                                                                  .compute("occlusion_cull.comp"));
+    hiz_copy_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                             shader_constants_)
+                                                       .compute("hiz_copy.comp"));
+    hiz_downsample_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                   shader_constants_)
+                                                             .compute("hiz_downsample.comp"));
+    glCreateBuffers(1, &objects_.occlusion_statistics_buffer.id);
+    glNamedBufferStorage(objects_.occlusion_statistics_buffer.id, sizeof(OcclusionStatistics), nullptr, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                     SSBOBinding::OCCLUSION_STATISTICS,
+                     objects_.occlusion_statistics_buffer.id);
+  }
+  if (config_.sdsm) {
+    depth_reduce_shader_ = std::make_unique<ShaderProgram>(ShaderProgram::Stages(config_.shader_source_path,
+                                                                                 shader_constants_)
+                                                           .compute("depth_reduce.comp"));
+    initializeDepthReductionBuffers();
+  }
+
+  initializeFrameDataBuffer();
+  if (config_.profile_gpu) {
+    gpu_profiler_ = std::make_unique<GpuProfiler>(PROFILED_PASS_NAMES, config_.profile_gpu_csv_path);
+  }
   glCreateFramebuffers(1, &objects_.scene_fbo.id);
   createSceneFramebufferAttachments();
+  if (config_.headless) initializeOutputFramebuffer();
   initializeCSMFramebuffer();
-
-  temple_model_->drawSetup(SSBOBinding::TEMPLE_VERTEX, TextureBinding::TEMPLE_ARRAY);
   skybox_->drawSetup(SSBOBinding::SKY_VERTEX, TextureBinding::SKY_CUBE_MAP);
+  if (temple_model_) templeSetup(); // otherwise called by pollModelLoad()
 
   glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
                        GL_DEBUG_TYPE_OTHER,
@@ -116,22 +358,30 @@ void Renderer::renderSetup() {
 }
 
 void Renderer::updateRenderState() {
-  const auto new_time {static_cast<float>(glfwGetTime())};
-  state_.delta_time   = new_time - state_.current_time;
-  state_.current_time = new_time;
+  PROFILE_ZONE("Renderer::updateRenderState");
+  if (isCameraScripted()) {
+    // Paths advance by a fixed time step, rather than by the time frames take, so every run renders the same frames
+    state_.delta_time = CameraPath::TIME_STEP;
+    state_.current_time += CameraPath::TIME_STEP;
+    const CameraPath::Pose pose {getScriptedCameraPose()};
+    camera_->setPose(pose.position, pose.yaw, pose.pitch);
+  } else {
+    const auto new_time {static_cast<float>(glfwGetTime())};
+    state_.delta_time   = new_time - state_.current_time;
+    state_.current_time = new_time;
+  }
+  if (camera_recorder_) {
+    camera_recorder_->record(state_.current_time, {camera_->getPosition(), camera_->getYaw(), camera_->getPitch()});
+  }
+  if (!temple_model_) pollModelLoad();
   camera_->updateViewMatrix();
-  glNamedBufferSubData(objects_.matrix_buffer.id,
-                       sizeof(glm::mat4),
-                       sizeof(glm::mat4),
-                       glm::value_ptr(camera_->getViewMatrix()));
-  glNamedBufferSubData(objects_.light_data_buffer.id,
-                       0,
-                       sizeof(glm::vec4),
-                       glm::value_ptr(glm::vec4(camera_->getPosition(), 1.0f)));
+  state_.frame_data.view            = camera_->getViewMatrix();
+  state_.frame_data.camera_position = glm::vec4(camera_->getPosition(), 1.0f);
 }
 
 void Renderer::processKeyboardInput() {
   Initializer::processKeyboardInput();
+  if (isCameraScripted()) return;
   if (glfwGetKey(window_, GLFW_KEY_W) == GLFW_PRESS) camera_->processKeyboard(Camera::FORWARD, state_.delta_time);
   if (glfwGetKey(window_, GLFW_KEY_S) == GLFW_PRESS) camera_->processKeyboard(Camera::BACKWARD, state_.delta_time);
   if (glfwGetKey(window_, GLFW_KEY_A) == GLFW_PRESS) camera_->processKeyboard(Camera::LEFT, state_.delta_time);
@@ -142,21 +392,58 @@ void Renderer::processKeyboardInput() {
 }
 
 void Renderer::render() {
+  PROFILE_ZONE("Renderer::render");
+  if (!temple_model_) {
+    renderLoadingScreen();
+    return;
+  }
+
+  if (gpu_profiler_) gpu_profiler_->beginFrame();
+
   /// Compute sunlight shadows
+  if (config_.sparse_shadows) { updateShadowPageResidency(); }
+  if (config_.sdsm) { readDepthReduction(); }
+  updateSunlightCascades();
+  uploadFrameData();
+  if (config_.clustered_shading && state_.cluster_bounds_outdated) { updateClusterBounds(); }
+  if (gpu_profiler_) gpu_profiler_->begin(SUNLIGHT_CSM_PASS);
   renderSunlightCSM();
+  if (gpu_profiler_) gpu_profiler_->end(SUNLIGHT_CSM_PASS);
 
   /// Render scene to framebuffer
   glBindFramebuffer(GL_FRAMEBUFFER, objects_.scene_fbo.id);
   glClear(GL_DEPTH_BUFFER_BIT);
   glNamedFramebufferDrawBuffer(objects_.scene_fbo.id, GL_COLOR_ATTACHMENT0 + SCENE_FBO_COLOR_INDEX_TEMPLE);
   glClear(GL_COLOR_BUFFER_BIT);
-  temple_model_->draw(temple_shader_);
+  if (config_.clustered_shading) {
+    if (gpu_profiler_) gpu_profiler_->begin(LIGHT_CULLING_PASS);
+    cullPointLights();
+    if (gpu_profiler_) gpu_profiler_->end(LIGHT_CULLING_PASS);
+  }
+  if (gpu_profiler_) gpu_profiler_->begin(TEMPLE_PASS);
+  // Cone culling assumes back faces are never visible, so the rasterizer should agree with it
+  if (config_.cone_culling) glEnable(GL_CULL_FACE);
+  if (config_.occlusion_culling) {
+    renderTempleTwoPhaseOcclusion();
+  } else if (config_.frustum_culling) {
+    temple_model_->cull(frustum_cull_shader_);
+    temple_model_->drawCulled(temple_shader_);
+  } else {
+    temple_model_->draw(temple_shader_);
+  }
+  glDisable(GL_CULL_FACE);
+  if (gpu_profiler_) gpu_profiler_->end(TEMPLE_PASS);
+  if (config_.sparse_shadows) { readBackShadowPageRequests(); }
+  if (gpu_profiler_) gpu_profiler_->begin(SKY_PASS);
   glNamedFramebufferDrawBuffer(objects_.scene_fbo.id, GL_COLOR_ATTACHMENT0 + SCENE_FBO_COLOR_INDEX_SKY);
   glClear(GL_COLOR_BUFFER_BIT);
   skybox_->draw(skybox_shader_);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (gpu_profiler_) gpu_profiler_->end(SKY_PASS);
+  glBindFramebuffer(GL_FRAMEBUFFER, getOutputFramebuffer());
+  if (config_.sdsm) { reduceSceneDepth(); }
 
   /// Post-processing and render to screen
+  if (gpu_profiler_) gpu_profiler_->begin(COMPOSITE_PASS);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   image_shader_->use();
   glDisable(GL_DEPTH_TEST);
@@ -166,10 +453,47 @@ void Renderer::render() {
     glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(std::ssize(temple_model_->light_positions_)));
   }
   glEnable(GL_DEPTH_TEST);
+  if (gpu_profiler_) gpu_profiler_->end(COMPOSITE_PASS);
+  fenceFrameData();
+
+  ++state_.frames_since_statistics_report;
+  if (config_.report_statistics && state_.current_time - state_.last_statistics_report_time >= 1.0f) {
+    reportStatistics();
+  }
+  if (gpu_profiler_ && state_.current_time - state_.last_profiler_report_time >= 1.0f) {
+    gpu_profiler_->report();
+    state_.last_profiler_report_time = state_.current_time;
+  }
+  if (benchmark_) advanceBenchmark();
+  if (golden_test_) advanceGoldenTest();
+  if (camera_replay_ && ++state_.replay_frame == camera_replay_->getNumFrames()) {
+    std::cout << std::format("INFO (Renderer::render): Replayed '{}' in {} frames.", camera_path_, state_.replay_frame)
+              << std::endl;
+    glfwSetWindowShouldClose(window_, true);
+  }
 }
 
 void Renderer::renderTerminate() {
-  // Placeholder. Thanks to RAII there is nothing that needs to be done here right now
+  // A model still being loaded holds the shared context, so it must finish before GLFW terminates
+  if (model_load_.thread.joinable()) model_load_.thread.join();
+  if (model_load_.fence) glDeleteSync(model_load_.fence);
+
+  // Sync objects are the only resources not covered by RAII wrappers
+  for (const GLsync fence : state_.shadow_pages.readback_fences) {
+    if (fence) glDeleteSync(fence);
+  }
+  for (const GLsync fence : state_.depth_reduction.readback_fences) {
+    if (fence) glDeleteSync(fence);
+  }
+  for (const GLsync fence : state_.frame_data_ring.fences) {
+    if (fence) glDeleteSync(fence);
+  }
+  if (camera_recorder_) {
+    std::cout << std::format("INFO (Renderer::renderTerminate): Recorded {} camera poses to '{}'.",
+                             camera_recorder_->getNumPoses(),
+                             camera_path_)
+              << std::endl;
+  }
   glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
                        GL_DEBUG_TYPE_OTHER,
                        0,
@@ -178,21 +502,159 @@ void Renderer::renderTerminate() {
                        "(Renderer::renderTerminate): Completed successfully.");
 }
 
-void Renderer::initializeMatrixBuffer() {
-  glCreateBuffers(1, &objects_.matrix_buffer.id);
-  glNamedBufferStorage(objects_.matrix_buffer.id,
-                       (2 + CSM_NUM_CASCADES) * sizeof(glm::mat4),
-                       nullptr,
-                       GL_DYNAMIC_STORAGE_BIT);
-  glNamedBufferSubData(objects_.matrix_buffer.id,
-                       0,
-                       sizeof(glm::mat4),
-                       glm::value_ptr(camera_->getProjectionMatrix()));
-  glNamedBufferSubData(objects_.matrix_buffer.id,
-                       sizeof(glm::mat4),
-                       sizeof(glm::mat4),
-                       glm::value_ptr(camera_->getViewMatrix()));
-  glBindBufferBase(GL_UNIFORM_BUFFER, UBOBinding::MATRIX, objects_.matrix_buffer.id);
+void Renderer::startModelLoad() {
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  model_load_.context = glfwCreateWindow(1, 1, "", nullptr, window_);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+  if (!model_load_.context) {
+    throw std::runtime_error("ERROR (Renderer::startModelLoad): Failed to create a shared OpenGL context.");
+  }
+  model_load_.start_time = static_cast<float>(glfwGetTime());
+  model_load_.thread     = std::jthread {[this] { loadTempleModel(); }};
+}
+
+void Renderer::loadTempleModel() {
+  PROFILE_THREAD_NAME("model loader");
+  PROFILE_ZONE("Renderer::loadTempleModel");
+  glfwMakeContextCurrent(model_load_.context);
+  configureDebugOutput();
+  try {
+    model_load_.model = std::make_unique<Model>(config_.model_source_path + "temple/",
+                                                config_.model_load_options,
+                                                [this](const float fraction) { model_load_.progress = fraction; });
+  } catch (std::exception& e) {
+    model_load_.error = e.what();
+  }
+  // Uploads from this context only become visible to the main context once the fence has been reached, and the fence
+  // can only be reached once it has been flushed
+  model_load_.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+  glfwMakeContextCurrent(nullptr);
+  model_load_.finished.store(true, std::memory_order_release);
+}
+
+void Renderer::pollModelLoad() {
+  if (!model_load_.finished.load(std::memory_order_acquire)) return;
+  if (!model_load_.error.empty()) {
+    throw std::runtime_error("ERROR (Renderer::pollModelLoad): Failed to load the temple model. Reason: "
+                             + model_load_.error);
+  }
+  if (glClientWaitSync(model_load_.fence, 0, 0) == GL_TIMEOUT_EXPIRED) return;
+  glDeleteSync(model_load_.fence);
+  model_load_.fence = nullptr;
+  model_load_.thread.join();
+  glfwDestroyWindow(model_load_.context);
+  model_load_.context = nullptr;
+
+  // Bindings are per context, so everything the loader created is bound again here
+  temple_model_ = std::move(model_load_.model);
+  templeSetup();
+  std::cout << std::format("INFO (Renderer::pollModelLoad): Temple model published after {:.0f} ms, "
+                           "{} frames were rendered while loading.",
+                           1000.0f * (static_cast<float>(glfwGetTime()) - model_load_.start_time),
+                           model_load_.frames_while_loading)
+            << std::endl;
+}
+
+void Renderer::templeSetup() {
+  PROFILE_GL_ZONE("Renderer::templeSetup");
+  initializeLightDataBuffer();
+  if (config_.clustered_shading) {
+    initializeClusterBuffers();
+    state_.cluster_bounds_outdated = true;
+  }
+  temple_model_->drawSetup(SSBOBinding::TEMPLE_VERTEX,
+                           TextureBinding::TEMPLE_DIFFUSE_ARRAY,
+                           TextureBinding::TEMPLE_NORMAL_ARRAY,
+                           TextureBinding::TEMPLE_SPECULAR_ARRAY);
+  temple_model_->cullSetup(SSBOBinding::DRAW_BOUNDS,
+                           SSBOBinding::DRAW_CONE,
+                           SSBOBinding::DRAW_LOD,
+                           SSBOBinding::DRAW_COMMAND,
+                           SSBOBinding::CULLED_DRAW_COMMAND,
+                           SSBOBinding::DRAW_COUNT,
+                           SSBOBinding::DRAW_VISIBILITY);
+  csm_draw_list_ = temple_model_->createCulledDrawList(CSM_NUM_CASCADES);
+}
+
+void Renderer::renderLoadingScreen() {
+  PROFILE_GL_ZONE("Renderer::renderLoadingScreen");
+  /// Render the sky alone, through the usual post-processing
+  uploadFrameData();
+  glBindFramebuffer(GL_FRAMEBUFFER, objects_.scene_fbo.id);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  glNamedFramebufferDrawBuffer(objects_.scene_fbo.id, GL_COLOR_ATTACHMENT0 + SCENE_FBO_COLOR_INDEX_TEMPLE);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glNamedFramebufferDrawBuffer(objects_.scene_fbo.id, GL_COLOR_ATTACHMENT0 + SCENE_FBO_COLOR_INDEX_SKY);
+  glClear(GL_COLOR_BUFFER_BIT);
+  skybox_->draw(skybox_shader_);
+  glBindFramebuffer(GL_FRAMEBUFFER, getOutputFramebuffer());
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  image_shader_->use();
+  glDisable(GL_DEPTH_TEST);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glEnable(GL_DEPTH_TEST);
+
+  /// Draw a progress bar along the bottom edge of the window, by clearing scissored rectangles
+  const GLsizei bar_height {std::max(config_.window_height / 100, 4)};
+  const auto bar_width {static_cast<GLsizei>(static_cast<float>(config_.window_width) * model_load_.progress)};
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(0, 0, config_.window_width, bar_height);
+  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glScissor(0, 0, bar_width, bar_height);
+  glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glDisable(GL_SCISSOR_TEST);
+  fenceFrameData();
+  ++model_load_.frames_while_loading;
+}
+
+void Renderer::initializeFrameDataBuffer() {
+  FrameData& frame {state_.frame_data};
+  frame.projection      = camera_->getProjectionMatrix();
+  frame.view            = camera_->getViewMatrix();
+  frame.viewport_size   = {static_cast<float>(config_.window_width), static_cast<float>(config_.window_height)};
+  frame.lod_pixel_error = config_.lod_pixel_error;
+  frame.camera_position = glm::vec4(camera_->getPosition(), 1.0f);
+
+  /// Each frame writes its data to the next of several persistently mapped slots, so the CPU never overwrites data
+  /// that the GPU may still be reading, and no driver call is needed to update it
+  FrameDataRing& ring {state_.frame_data_ring};
+  GLint offset_alignment;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+  ring.slot_size = (static_cast<GLsizeiptr>(sizeof(FrameData)) + offset_alignment - 1) / offset_alignment
+                   * offset_alignment;
+  const auto buffer_size {ring.slot_size * std::ssize(ring.fences)};
+  constexpr GLbitfield map_flags {GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT};
+  glCreateBuffers(1, &objects_.frame_data_buffer.id);
+  glNamedBufferStorage(objects_.frame_data_buffer.id, buffer_size, nullptr, map_flags);
+  ring.mapping = static_cast<std::byte*>(glMapNamedBufferRange(objects_.frame_data_buffer.id,
+                                                               0,
+                                                               buffer_size,
+                                                               map_flags));
+}
+
+void Renderer::uploadFrameData() {
+  PROFILE_ZONE("Renderer::uploadFrameData");
+  FrameDataRing& ring {state_.frame_data_ring};
+  const size_t slot {ring.frame % ring.fences.size()};
+  if (ring.fences[slot]) {
+    // Never blocks, since frame pacing keeps at most MAX_FRAMES_IN_FLIGHT == fences.size() frames in flight
+    while (glClientWaitSync(ring.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(ring.fences[slot]);
+    ring.fences[slot] = nullptr;
+  }
+  const auto offset {static_cast<GLintptr>(slot) * ring.slot_size};
+  std::memcpy(ring.mapping + offset, &state_.frame_data, sizeof(FrameData));
+  glBindBufferRange(GL_UNIFORM_BUFFER, UBOBinding::FRAME, objects_.frame_data_buffer.id, offset, sizeof(FrameData));
+}
+
+void Renderer::fenceFrameData() {
+  FrameDataRing& ring {state_.frame_data_ring};
+  ring.fences[ring.frame % ring.fences.size()] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ++ring.frame;
 }
 
 void Renderer::initializeLightDataBuffer() {
@@ -204,38 +666,16 @@ void Renderer::initializeLightDataBuffer() {
 
   glCreateBuffers(1, &objects_.light_data_buffer.id);
   glNamedBufferStorage(objects_.light_data_buffer.id,
-                       static_cast<GLsizeiptr>(sizeof(glm::vec4)
-                                               + static_cast<size_t>(std::ceil(CSM_NUM_CASCADES / 4.0f))
-                                               * sizeof(glm::vec4)
-                                               + sizeof(Light)
+                       static_cast<GLsizeiptr>(sizeof(Light)
                                                + sizeof(glm::vec4)
                                                + std::ssize(point_lights) * sizeof(Light)),
                        nullptr,
                        GL_DYNAMIC_STORAGE_BIT);
-  glNamedBufferSubData(objects_.light_data_buffer.id,
-                       0,
-                       sizeof(glm::vec4),
-                       glm::value_ptr(glm::vec4(camera_->getPosition(), 1.0f)));
-  glNamedBufferSubData(objects_.light_data_buffer.id,
-                       static_cast<GLintptr>(sizeof(glm::vec4)
-                                             + static_cast<size_t>(std::ceil(CSM_NUM_CASCADES / 4.0f))
-                                             * sizeof(glm::vec4)),
-                       sizeof(Light),
-                       &SUNLIGHT);
+  glNamedBufferSubData(objects_.light_data_buffer.id, 0, sizeof(Light), &SUNLIGHT);
   const auto num_point_lights {static_cast<GLuint>(std::ssize(point_lights))};
+  glNamedBufferSubData(objects_.light_data_buffer.id, sizeof(Light), sizeof(GLuint), &num_point_lights);
   glNamedBufferSubData(objects_.light_data_buffer.id,
-                       static_cast<GLintptr>(sizeof(glm::vec4)
-                                             + static_cast<size_t>(std::ceil(CSM_NUM_CASCADES / 4.0f))
-                                             * sizeof(glm::vec4)
-                                             + sizeof(Light)),
-                       sizeof(GLuint),
-                       &num_point_lights);
-  glNamedBufferSubData(objects_.light_data_buffer.id,
-                       static_cast<GLintptr>(sizeof(glm::vec4)
-                                             + static_cast<size_t>(std::ceil(CSM_NUM_CASCADES / 4.0f))
-                                             * sizeof(glm::vec4)
-                                             + sizeof(Light)
-                                             + sizeof(glm::vec4)),
+                       static_cast<GLintptr>(sizeof(Light) + sizeof(glm::vec4)),
                        static_cast<GLsizeiptr>(std::ssize(point_lights) * sizeof(Light)),
                        point_lights.data());
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBOBinding::LIGHT_DATA, objects_.light_data_buffer.id);
@@ -263,31 +703,63 @@ void Renderer::createSceneFramebufferAttachments() {
                               objects_.scene_fbo_color[i]->id,
                               0);
   }
-  glDeleteRenderbuffers(1, &objects_.scene_fbo_depth.id);
-  glCreateRenderbuffers(1, &objects_.scene_fbo_depth.id);
-  glNamedRenderbufferStorage(objects_.scene_fbo_depth.id,
-                             GL_DEPTH_COMPONENT32F,
-                             config_.window_width,
-                             config_.window_height);
-  glNamedFramebufferRenderbuffer(objects_.scene_fbo.id,
-                                 GL_DEPTH_ATTACHMENT,
-                                 GL_RENDERBUFFER,
-                                 objects_.scene_fbo_depth.id);
+  // Depth is a texture rather than a renderbuffer, so that the Hi-Z pyramid can be built from it
+  glDeleteTextures(1, &objects_.scene_fbo_depth.id);
+  glCreateTextures(GL_TEXTURE_2D, 1, &objects_.scene_fbo_depth.id);
+  glTextureParameteri(objects_.scene_fbo_depth.id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTextureParameteri(objects_.scene_fbo_depth.id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTextureStorage2D(objects_.scene_fbo_depth.id,
+                     1,
+                     GL_DEPTH_COMPONENT32F,
+                     config_.window_width,
+                     config_.window_height);
+  glNamedFramebufferTexture(objects_.scene_fbo.id, GL_DEPTH_ATTACHMENT, objects_.scene_fbo_depth.id, 0);
 
   checkFramebufferErrors(objects_.scene_fbo);
 
   glBindTextureUnit(TextureBinding::SCENE_TEMPLE, objects_.scene_fbo_color[SCENE_FBO_COLOR_INDEX_TEMPLE]->id);
   glBindTextureUnit(TextureBinding::SCENE_SKY, objects_.scene_fbo_color[SCENE_FBO_COLOR_INDEX_SKY]->id);
+  glBindTextureUnit(TextureBinding::SCENE_DEPTH, objects_.scene_fbo_depth.id);
+
+  /// Hi-Z pyramid. The base level is rounded down to a power of two, so that every level is exactly half the size of
+  /// the previous one, and texel footprints line up when sampling it with normalized coordinates.
+  if (config_.occlusion_culling) {
+    const GLsizei hiz_width {static_cast<GLsizei>(std::bit_floor(static_cast<GLuint>(config_.window_width)))};
+    const GLsizei hiz_height {static_cast<GLsizei>(std::bit_floor(static_cast<GLuint>(config_.window_height)))};
+    glDeleteTextures(1, &objects_.hiz_pyramid.id);
+    glCreateTextures(GL_TEXTURE_2D, 1, &objects_.hiz_pyramid.id);
+    glTextureParameteri(objects_.hiz_pyramid.id, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(objects_.hiz_pyramid.id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureStorage2D(objects_.hiz_pyramid.id,
+                       std::bit_width(static_cast<GLuint>(std::max(hiz_width, hiz_height))),
+                       GL_R32F,
+                       hiz_width,
+                       hiz_height);
+    glBindTextureUnit(TextureBinding::HIZ_PYRAMID, objects_.hiz_pyramid.id);
+  }
+}
+
+void Renderer::initializeOutputFramebuffer() {
+  glCreateFramebuffers(1, &objects_.output_fbo.id);
+  glCreateTextures(GL_TEXTURE_2D, 1, &objects_.output_fbo_color.id);
+  glTextureStorage2D(objects_.output_fbo_color.id, 1, GL_RGBA8, config_.window_width, config_.window_height);
+  glNamedFramebufferTexture(objects_.output_fbo.id, GL_COLOR_ATTACHMENT0, objects_.output_fbo_color.id, 0);
+  checkFramebufferErrors(objects_.output_fbo);
 }
 
 void Renderer::initializeCSMFramebuffer() {
   glCreateFramebuffers(1, &objects_.csm_fbo.id);
   glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &objects_.csm_fbo_depth.id);
+  if (config_.sparse_shadows) {
+    const ShadowPageState& pages {state_.shadow_pages};
+    glTextureParameteri(objects_.csm_fbo_depth.id, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+    glTextureParameteri(objects_.csm_fbo_depth.id, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, pages.page_size_index);
+  }
   glTextureStorage3D(objects_.csm_fbo_depth.id,
                      1,
-                     GL_DEPTH_COMPONENT32F,
-                     CSM_TEX_SIZE,
-                     CSM_TEX_SIZE,
+                     config_.shadow_depth_format,
+                     config_.shadow_resolution,
+                     config_.shadow_resolution,
                      CSM_NUM_CASCADES);
   glTextureParameteri(objects_.csm_fbo_depth.id, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
   glTextureParameteri(objects_.csm_fbo_depth.id, GL_TEXTURE_COMPARE_FUNC, GL_LESS);
@@ -301,50 +773,521 @@ void Renderer::initializeCSMFramebuffer() {
   checkFramebufferErrors(objects_.csm_fbo);
 
   glBindTextureUnit(TextureBinding::SUN_CSM_ARRAY, objects_.csm_fbo_depth.id);
+
+  if (config_.sparse_shadows) { initializeShadowPageBuffers(); }
+}
+
+bool Renderer::querySparseShadowPageSize() {
+  if (!GLAD_GL_ARB_sparse_texture) return false;
+  GLint max_layers;
+  glGetIntegerv(GL_MAX_SPARSE_ARRAY_TEXTURE_LAYERS_ARB, &max_layers);
+  if (max_layers < static_cast<GLint>(CSM_NUM_CASCADES)) return false;
+  GLint num_page_sizes;
+  glGetInternalformativ(GL_TEXTURE_2D_ARRAY,
+                        config_.shadow_depth_format,
+                        GL_NUM_VIRTUAL_PAGE_SIZES_ARB,
+                        1,
+                        &num_page_sizes);
+  if (num_page_sizes <= 0) return false;
+  // Use the first (implementation-preferred) page size
+  ShadowPageState& pages {state_.shadow_pages};
+  glGetInternalformativ(GL_TEXTURE_2D_ARRAY,
+                        config_.shadow_depth_format,
+                        GL_VIRTUAL_PAGE_SIZE_X_ARB,
+                        1,
+                        &pages.page_size_x);
+  glGetInternalformativ(GL_TEXTURE_2D_ARRAY,
+                        config_.shadow_depth_format,
+                        GL_VIRTUAL_PAGE_SIZE_Y_ARB,
+                        1,
+                        &pages.page_size_y);
+  pages.page_size_index = 0;
+  return true;
+}
+
+void Renderer::clampShadowResolution() {
+  /// Sparse arrays have their own size limit. Fully resident arrays are instead capped to a memory budget, since
+  /// every texel of every cascade is allocated up front.
+  GLint max_resolution;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_resolution);
+  std::string limit {"GL_MAX_TEXTURE_SIZE"};
+  if (config_.sparse_shadows) {
+    GLint max_sparse_resolution;
+    glGetIntegerv(GL_MAX_SPARSE_TEXTURE_SIZE_ARB, &max_sparse_resolution);
+    if (max_sparse_resolution < max_resolution) {
+      max_resolution = max_sparse_resolution;
+      limit          = "GL_MAX_SPARSE_TEXTURE_SIZE_ARB";
+    }
+  } else if (config_.shadow_resident_resolution < max_resolution) {
+    max_resolution = config_.shadow_resident_resolution;
+    limit          = "shadows.resident_resolution (shadow maps are fully resident)";
+  }
+  if (config_.shadow_resolution > max_resolution) {
+    std::cerr << std::format("WARNING (Renderer::clampShadowResolution): shadows.resolution exceeds {}. "
+                             "Defaulting to {}.",
+                             limit,
+                             max_resolution)
+              << std::endl;
+    config_.shadow_resolution = max_resolution;
+  }
+  if (!config_.sparse_shadows) return;
+
+  /// Sparse textures must be a whole number of pages in size. Round up, unless that exceeds the limit again.
+  ShadowPageState& pages {state_.shadow_pages};
+  const GLsizei page_multiple {std::lcm(pages.page_size_x, pages.page_size_y)};
+  config_.shadow_resolution = (config_.shadow_resolution + page_multiple - 1) / page_multiple * page_multiple;
+  if (config_.shadow_resolution > max_resolution) {
+    config_.shadow_resolution = max_resolution / page_multiple * page_multiple;
+  }
+  pages.pages_x = config_.shadow_resolution / pages.page_size_x;
+  pages.pages_y = config_.shadow_resolution / pages.page_size_y;
+}
+
+void Renderer::initializeShadowPageBuffers() {
+  ShadowPageState& pages {state_.shadow_pages};
+  const auto num_pages {static_cast<size_t>(pages.pages_x * pages.pages_y) * CSM_NUM_CASCADES};
+  pages.residency.assign(num_pages, 0);
+  pages.last_requested_frame.assign(num_pages, SHADOW_PAGE_NEVER_REQUESTED);
+
+  /// Residency flags, read by the fragment shader to avoid sampling uncommitted pages
+  const std::array page_grid {static_cast<GLuint>(pages.pages_x), static_cast<GLuint>(pages.pages_y)};
+  glCreateBuffers(1, &objects_.shadow_page_residency_buffer.id);
+  glNamedBufferStorage(objects_.shadow_page_residency_buffer.id,
+                       static_cast<GLsizeiptr>(sizeof(page_grid) + num_pages * sizeof(GLuint)),
+                       nullptr,
+                       GL_DYNAMIC_STORAGE_BIT);
+  glNamedBufferSubData(objects_.shadow_page_residency_buffer.id, 0, sizeof(page_grid), page_grid.data());
+  glNamedBufferSubData(objects_.shadow_page_residency_buffer.id,
+                       sizeof(page_grid),
+                       static_cast<GLsizeiptr>(num_pages * sizeof(GLuint)),
+                       pages.residency.data());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                   SSBOBinding::SHADOW_PAGE_RESIDENCY,
+                   objects_.shadow_page_residency_buffer.id);
+
+  /// Request flags, written by the fragment shader for every page it samples
+  glCreateBuffers(1, &objects_.shadow_page_request_buffer.id);
+  glNamedBufferStorage(objects_.shadow_page_request_buffer.id,
+                       static_cast<GLsizeiptr>(num_pages * sizeof(GLuint)),
+                       nullptr,
+                       0);
+  glClearNamedBufferData(objects_.shadow_page_request_buffer.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBOBinding::SHADOW_PAGE_REQUEST, objects_.shadow_page_request_buffer.id);
+
+  /// Requests are copied into one of two persistently mapped slots, and read by the CPU a frame later
+  constexpr GLbitfield map_flags {GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT};
+  glCreateBuffers(1, &objects_.shadow_page_readback_buffer.id);
+  glNamedBufferStorage(objects_.shadow_page_readback_buffer.id,
+                       static_cast<GLsizeiptr>(2 * num_pages * sizeof(GLuint)),
+                       nullptr,
+                       map_flags);
+  pages.readback_data = static_cast<const GLuint*>(glMapNamedBufferRange(objects_.shadow_page_readback_buffer.id,
+                                                                         0,
+                                                                         static_cast<GLsizeiptr>(2 * num_pages
+                                                                                                 * sizeof(GLuint)),
+                                                                         map_flags));
+}
+
+void Renderer::readBackShadowPageRequests() {
+  PROFILE_GL_ZONE("Renderer::readBackShadowPageRequests");
+  ShadowPageState& pages {state_.shadow_pages};
+  const size_t num_pages {pages.residency.size()};
+  const size_t slot {pages.frame % 2};
+  if (pages.readback_fences[slot]) glDeleteSync(pages.readback_fences[slot]);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glCopyNamedBufferSubData(objects_.shadow_page_request_buffer.id,
+                           objects_.shadow_page_readback_buffer.id,
+                           0,
+                           static_cast<GLintptr>(slot * num_pages * sizeof(GLuint)),
+                           static_cast<GLsizeiptr>(num_pages * sizeof(GLuint)));
+  pages.readback_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glClearNamedBufferData(objects_.shadow_page_request_buffer.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  ++pages.frame;
+}
+
+void Renderer::initializeDepthReductionBuffers() {
+  glCreateBuffers(1, &objects_.depth_reduction_buffer.id);
+  glNamedBufferStorage(objects_.depth_reduction_buffer.id, sizeof(DepthReduction), nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBOBinding::DEPTH_REDUCTION, objects_.depth_reduction_buffer.id);
+
+  /// Results are copied into one of two persistently mapped slots, and read by the CPU a frame later
+  constexpr GLbitfield map_flags {GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT};
+  glCreateBuffers(1, &objects_.depth_reduction_readback_buffer.id);
+  glNamedBufferStorage(objects_.depth_reduction_readback_buffer.id, 2 * sizeof(DepthReduction), nullptr, map_flags);
+  state_.depth_reduction.readback_data = static_cast<const DepthReduction*>(glMapNamedBufferRange(
+    objects_.depth_reduction_readback_buffer.id,
+    0,
+    2 * sizeof(DepthReduction),
+    map_flags));
+}
+
+void Renderer::reduceSceneDepth() {
+  PROFILE_GL_ZONE("Renderer::reduceSceneDepth");
+  DepthReductionState& reduction {state_.depth_reduction};
+  DepthReduction reset {};
+  reset.view_to_sunlight_view = getSunlightViewMatrix() * glm::inverse(camera_->getViewMatrix());
+  reset.min_view_depth        = std::numeric_limits<GLuint>::max();
+  reset.max_view_depth        = 0;
+  for (size_t i = 0; i < CSM_NUM_CASCADES; ++i) {
+    reset.light_bounds_min[i] = glm::uvec4(std::numeric_limits<GLuint>::max());
+    reset.light_bounds_max[i] = glm::uvec4(0);
+  }
+  glNamedBufferSubData(objects_.depth_reduction_buffer.id, 0, sizeof(DepthReduction), &reset);
+
+  depth_reduce_shader_->use();
+  glDispatchCompute((config_.window_width + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE,
+                    (config_.window_height + DEPTH_REDUCE_GROUP_SIZE - 1) / DEPTH_REDUCE_GROUP_SIZE,
+                    1);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  const size_t slot {reduction.frame % 2};
+  if (reduction.readback_fences[slot]) glDeleteSync(reduction.readback_fences[slot]);
+  glCopyNamedBufferSubData(objects_.depth_reduction_buffer.id,
+                           objects_.depth_reduction_readback_buffer.id,
+                           0,
+                           static_cast<GLintptr>(slot * sizeof(DepthReduction)),
+                           sizeof(DepthReduction));
+  reduction.readback_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ++reduction.frame;
+}
+
+void Renderer::readDepthReduction() {
+  PROFILE_ZONE("Renderer::readDepthReduction");
+  /// Use last frame's result if the GPU is done with it. Otherwise keep the older one rather than stalling.
+  DepthReductionState& reduction {state_.depth_reduction};
+  const size_t slot {(reduction.frame + 1) % 2};
+  if (!reduction.readback_fences[slot]
+      || glClientWaitSync(reduction.readback_fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) return;
+  glDeleteSync(reduction.readback_fences[slot]);
+  reduction.readback_fences[slot] = nullptr;
+  reduction.latest                = reduction.readback_data[slot];
+  // An empty view (e.g. only sky) leaves min above max, in which case the default splits are used
+  reduction.valid = reduction.latest.min_view_depth <= reduction.latest.max_view_depth;
+}
+
+void Renderer::updateShadowPageResidency() {
+  PROFILE_GL_ZONE("Renderer::updateShadowPageResidency");
+  /// Read the requests copied last frame. If the GPU has not finished with them yet, try again next frame rather than
+  /// stalling.
+  ShadowPageState& pages {state_.shadow_pages};
+  const size_t slot {(pages.frame + 1) % 2};
+  if (!pages.readback_fences[slot]
+      || glClientWaitSync(pages.readback_fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) return;
+  glDeleteSync(pages.readback_fences[slot]);
+  pages.readback_fences[slot] = nullptr;
+
+  /// Commit newly requested pages, and release pages that have not been requested for a while. Adjacent pages of a
+  /// row that change the same way are (de)committed by a single call.
+  const size_t num_pages {pages.residency.size()};
+  const GLuint* requests {pages.readback_data + slot * num_pages};
+  bool residency_changed {false};
+  GLint previous_binding {0};
+  if (!GLAD_GL_EXT_direct_state_access) {
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previous_binding);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, objects_.csm_fbo_depth.id);
+  }
+  const auto commitPages {[&](const GLint layer,
+                              const GLint page_y,
+                              const GLint first_x,
+                              const GLint end_x,
+                              const bool commit) {
+    const GLint x {first_x * pages.page_size_x};
+    const GLint y {page_y * pages.page_size_y};
+    const GLsizei width {(end_x - first_x) * pages.page_size_x};
+    if (GLAD_GL_EXT_direct_state_access) {
+      glTexturePageCommitmentEXT(objects_.csm_fbo_depth.id, 0, x, y, layer, width, pages.page_size_y, 1, commit);
+    } else {
+      glTexPageCommitmentARB(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, width, pages.page_size_y, 1, commit);
+    }
+    // Freshly committed pages have undefined contents, so that part of the cascade needs to be rendered again
+    if (commit) {
+      glm::ivec4& dirty_region {state_.csm_cascades[layer].dirty_region};
+      dirty_region = uniteRegions(dirty_region, {x, y, x + width, y + pages.page_size_y});
+    }
+  }};
+  for (GLint layer = 0; layer < static_cast<GLint>(CSM_NUM_CASCADES); ++layer) {
+    for (GLint page_y = 0; page_y < pages.pages_y; ++page_y) {
+      GLint run_start {-1}; // first page of the current run of changes, or -1 if there is none
+      bool run_commits {false};
+      for (GLint page_x = 0; page_x <= pages.pages_x; ++page_x) {
+        bool changed {false};
+        bool wanted {false};
+        if (page_x < pages.pages_x) {
+          const auto i {static_cast<size_t>((layer * pages.pages_y + page_y) * pages.pages_x + page_x)};
+          if (requests[i]) pages.last_requested_frame[i] = pages.frame;
+          const GLuint last_requested_frame {pages.last_requested_frame[i]};
+          wanted  = last_requested_frame != SHADOW_PAGE_NEVER_REQUESTED
+                    && pages.frame - last_requested_frame < SHADOW_PAGE_EVICTION_FRAMES;
+          changed = wanted != static_cast<bool>(pages.residency[i]);
+          if (changed) {
+            pages.residency[i] = wanted;
+            pages.committed_pages += wanted ? 1 : -1;
+            residency_changed = true;
+          }
+        }
+        if (run_start >= 0 && (!changed || wanted != run_commits)) {
+          commitPages(layer, page_y, run_start, page_x, run_commits);
+          run_start = -1;
+        }
+        if (changed && run_start < 0) {
+          run_start   = page_x;
+          run_commits = wanted;
+        }
+      }
+    }
+  }
+  if (!GLAD_GL_EXT_direct_state_access) glBindTexture(GL_TEXTURE_2D_ARRAY, previous_binding);
+  if (residency_changed) {
+    glNamedBufferSubData(objects_.shadow_page_residency_buffer.id,
+                         2 * sizeof(GLuint),
+                         static_cast<GLsizeiptr>(num_pages * sizeof(GLuint)),
+                         pages.residency.data());
+  }
 }
 
-void Renderer::renderSunlightCSM() const {
-  /// Use Practical Split Scheme algorithm to determine view frustum split positions
-  std::array<glm::mat4, CSM_NUM_CASCADES> light_matrices {};
-  const float ratio {std::pow(config_.camera_far_plane / config_.camera_near_plane, 1.0f / CSM_NUM_CASCADES)};
-  const float step {(config_.camera_far_plane - config_.camera_near_plane) / CSM_NUM_CASCADES};
-  float split_log {config_.camera_near_plane};
-  float split_uni {config_.camera_near_plane};
-  float split_blend {config_.camera_near_plane};
+void Renderer::updateSunlightCascades() {
+  PROFILE_ZONE("Renderer::updateSunlightCascades");
+  /// Use Practical Split Scheme algorithm to determine view frustum split positions. With SDSM, the splits only span
+  /// the depth range that was actually visible last frame. Then check, for each cascade, whether the box it was last
+  /// rendered with still covers the bounding sphere (or with SDSM, the visible samples) of its partition.
+  GLuint update_mask {0};
+  GLuint partial_update_mask {0};
+  float split_near {config_.camera_near_plane};
+  float split_far {config_.camera_far_plane};
+  if (config_.sdsm && state_.depth_reduction.valid) {
+    split_near = glm::clamp(std::bit_cast<float>(state_.depth_reduction.latest.min_view_depth & 0x7FFFFFFFu),
+                            config_.camera_near_plane,
+                            config_.camera_far_plane);
+    split_far  = glm::clamp(std::bit_cast<float>(state_.depth_reduction.latest.max_view_depth & 0x7FFFFFFFu),
+                            split_near,
+                            config_.camera_far_plane);
+  }
+  const float ratio {std::pow(split_far / split_near, 1.0f / CSM_NUM_CASCADES)};
+  const float step {(split_far - split_near) / CSM_NUM_CASCADES};
+  float split_log {split_near};
+  float split_uni {split_near};
+  float split_blend {split_near};
   for (size_t i = 0; i < CSM_NUM_CASCADES; ++i) {
     const float split_prev {split_blend};
-    split_log         *= ratio;
-    split_uni         += step;
-    split_blend       = (split_log + split_uni) / 2.0f;
-    light_matrices[i] = getSunlightMatrixForCascade(split_prev, split_blend);
-    glNamedBufferSubData(objects_.light_data_buffer.id,
-                         static_cast<GLintptr>(sizeof(glm::vec4) + i * sizeof(GLfloat)),
-                         sizeof(GLfloat),
-                         &split_blend);
-  }
-  glNamedBufferSubData(objects_.matrix_buffer.id,
-                       2 * sizeof(glm::mat4),
-                       CSM_NUM_CASCADES * sizeof(glm::mat4),
-                       light_matrices.data());
-
-  /// Render shadow maps
-  glViewport(0, 0, CSM_TEX_SIZE, CSM_TEX_SIZE);
+    split_log   *= ratio;
+    split_uni   += step;
+    split_blend = (split_log + split_uni) / 2.0f;
+    state_.frame_data.csm_partition_depths[static_cast<int>(i)] = split_blend;
+
+    // Fit to the visible samples if there are any, and otherwise keep the bounding sphere of the partition
+    auto [center, radius] {getCascadeBoundingSphere(split_prev, split_blend)};
+    glm::vec3 sample_center;
+    float sample_half_extent;
+    const bool fit_to_samples {config_.sdsm && getSampleDistributionBounds(i, sample_center, sample_half_extent)};
+    if (fit_to_samples) {
+      center = sample_center;
+      radius = sample_half_extent;
+    }
+    ShadowCascade& cascade {state_.csm_cascades[i]};
+    ++cascade.frames_since_update;
+    const glm::vec3 offset {glm::abs(center - cascade.center)};
+    // With SDSM the required box can also shrink, in which case a cached box wastes resolution
+    const bool covered {cascade.valid
+                        && glm::max(offset.x, glm::max(offset.y, offset.z)) + radius <= cascade.half_extent
+                        && (!fit_to_samples
+                            || cascade.half_extent <= 2.0f * radius * (1.0f + config_.shadow_cache_padding))};
+    const bool update_allowed {!cascade.valid
+                               || cascade.frames_since_update >= config_.shadow_update_intervals[i]};
+    if (!config_.shadow_cache || (!covered && update_allowed)) {
+      // Cached cascades are enlarged, so that they stay valid while the camera moves around a bit
+      cascade.half_extent = config_.shadow_cache ? radius * (1.0f + config_.shadow_cache_padding) : radius;
+      // Snap the box to whole shadow map texels, so that moving it does not make shadow edges shimmer
+      const float texel_size {2.0f * cascade.half_extent / static_cast<float>(config_.shadow_resolution)};
+      cascade.center              = glm::vec3(glm::floor(glm::vec2(center) / texel_size) * texel_size, center.z);
+      cascade.light_matrix        = getSunlightMatrixForCascade(cascade.center, cascade.half_extent);
+      cascade.frames_since_update = 0;
+      cascade.valid               = true;
+      update_mask |= 1u << i;
+    } else if (cascade.dirty_region.x < cascade.dirty_region.z) {
+      // Only newly committed sparse pages need rendering, with the box the rest of the cascade was rendered with
+      update_mask |= 1u << i;
+      partial_update_mask |= 1u << i;
+    }
+    state_.frame_data.sunlight_transform[i] = cascade.light_matrix;
+  }
+  state_.csm_cascades_refreshed += std::popcount(update_mask);
+  state_.csm_partial_update_mask    = partial_update_mask;
+  state_.frame_data.csm_update_mask = update_mask;
+}
+
+void Renderer::renderSunlightCSM() {
+  PROFILE_GL_ZONE("Renderer::renderSunlightCSM");
+  const GLuint update_mask {state_.frame_data.csm_update_mask};
+  if (!update_mask) return;
+
+  /// Cull draw commands against each cascade that needs updating, emitting one instance per cascade in which a draw
+  /// is visible
+  temple_model_->cull(csm_cull_shader_, csm_draw_list_);
+
+  /// Render shadow maps. Cascades that only gained sparse pages are cleared and rasterized within those pages (the
+  /// scissor is shared by all cascades, so it only applies if no cascade is rendered in full).
+  constexpr float clear_depth {1.0f};
+  const bool only_partial_updates {state_.csm_partial_update_mask == update_mask};
+  glm::ivec4 scissor_region {0};
+  for (GLint i = 0; i < static_cast<GLint>(CSM_NUM_CASCADES); ++i) {
+    if (!(update_mask & 1u << i)) continue;
+    glm::ivec4& dirty_region {state_.csm_cascades[i].dirty_region};
+    const glm::ivec4 region {state_.csm_partial_update_mask & 1u << i
+                               ? dirty_region
+                               : glm::ivec4(0, 0, config_.shadow_resolution, config_.shadow_resolution)};
+    glClearTexSubImage(objects_.csm_fbo_depth.id,
+                       0,
+                       region.x,
+                       region.y,
+                       i,
+                       region.z - region.x,
+                       region.w - region.y,
+                       1,
+                       GL_DEPTH_COMPONENT,
+                       GL_FLOAT,
+                       &clear_depth);
+    scissor_region = uniteRegions(scissor_region, region);
+    dirty_region   = glm::ivec4(0);
+  }
+  glViewport(0, 0, config_.shadow_resolution, config_.shadow_resolution);
+  if (only_partial_updates) {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(scissor_region.x,
+              scissor_region.y,
+              scissor_region.z - scissor_region.x,
+              scissor_region.w - scissor_region.y);
+  }
   glBindFramebuffer(GL_FRAMEBUFFER, objects_.csm_fbo.id);
-  glClear(GL_DEPTH_BUFFER_BIT);
-  temple_model_->draw(csm_shader_);
+  temple_model_->drawCulled(csm_shader_, csm_draw_list_);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (only_partial_updates) glDisable(GL_SCISSOR_TEST);
   glViewport(0, 0, config_.window_width, config_.window_height);
 }
 
+void Renderer::initializeClusterBuffers() {
+  const std::array cluster_header {static_cast<float>(config_.window_width),
+                                   static_cast<float>(config_.window_height),
+                                   config_.camera_near_plane,
+                                   config_.camera_far_plane};
+  glCreateBuffers(1, &objects_.cluster_buffer.id);
+  glNamedBufferStorage(objects_.cluster_buffer.id,
+                       CLUSTER_BUFFER_HEADER_SIZE
+                       + CLUSTER_COUNT * CLUSTER_SIZE
+                       + std::ssize(temple_model_->light_positions_) * VISIBLE_LIGHT_SIZE,
+                       nullptr,
+                       GL_DYNAMIC_STORAGE_BIT);
+  glNamedBufferSubData(objects_.cluster_buffer.id, 0, sizeof(cluster_header), cluster_header.data());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBOBinding::CLUSTER, objects_.cluster_buffer.id);
+
+  glCreateBuffers(1, &objects_.cluster_light_index_buffer.id);
+  glNamedBufferStorage(objects_.cluster_light_index_buffer.id,
+                       CLUSTER_COUNT * CLUSTER_MAX_LIGHTS * sizeof(GLuint),
+                       nullptr,
+                       0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBOBinding::CLUSTER_LIGHT_INDEX, objects_.cluster_light_index_buffer.id);
+}
+
+void Renderer::updateClusterBounds() {
+  cluster_bounds_shader_->use();
+  glDispatchCompute(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  state_.cluster_bounds_outdated = false;
+}
+
+void Renderer::cullPointLights() const {
+  PROFILE_GL_ZONE("Renderer::cullPointLights");
+  /// Reset the visible light and light index counters (stored after screen size and near/far planes)
+  glClearNamedBufferSubData(objects_.cluster_buffer.id,
+                            GL_R32UI,
+                            sizeof(glm::vec4),
+                            2 * sizeof(GLuint),
+                            GL_RED_INTEGER,
+                            GL_UNSIGNED_INT,
+                            nullptr);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  /// Gather lights whose sphere of influence intersects the view frustum, so that the per-cluster pass below scales
+  /// with the number of lights near the camera instead of the total light count
+  const auto num_point_lights {static_cast<GLuint>(std::ssize(temple_model_->light_positions_))};
+  light_frustum_cull_shader_->use();
+  glDispatchCompute((num_point_lights + LIGHT_CULL_GROUP_SIZE - 1) / LIGHT_CULL_GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  /// Build compact per-cluster light index lists
+  light_cluster_cull_shader_->use();
+  glDispatchCompute((CLUSTER_COUNT + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Renderer::renderTempleTwoPhaseOcclusion() const {
+  PROFILE_GL_ZONE("Renderer::renderTempleTwoPhaseOcclusion");
+  glClearNamedBufferData(objects_.occlusion_statistics_buffer.id,
+                         GL_R32UI,
+                         GL_RED_INTEGER,
+                         GL_UNSIGNED_INT,
+                         nullptr);
+
+  /// Early phase: draw everything that was visible last frame (and is still inside the view frustum)
+  temple_model_->cull(occlusion_cull_early_shader_);
+  temple_model_->drawCulled(temple_shader_);
+
+  /// Late phase: test the remaining draws against the depth of the early phase, and draw the newly visible ones
+  buildHiZPyramid();
+  temple_model_->cull(occlusion_cull_late_shader_);
+  temple_model_->drawCulled(temple_shader_);
+}
+
+void Renderer::buildHiZPyramid() const {
+  PROFILE_GL_ZONE("Renderer::buildHiZPyramid");
+  GLint width, height, num_levels;
+  glGetTextureLevelParameteriv(objects_.hiz_pyramid.id, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTextureLevelParameteriv(objects_.hiz_pyramid.id, 0, GL_TEXTURE_HEIGHT, &height);
+  glGetTextureParameteriv(objects_.hiz_pyramid.id, GL_TEXTURE_IMMUTABLE_LEVELS, &num_levels);
+
+  /// Level 0 takes the farthest depth of the screen pixels covered by each texel
+  hiz_copy_shader_->use();
+  glBindImageTexture(ImageBinding::HIZ_DESTINATION, objects_.hiz_pyramid.id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+  glDispatchCompute((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+
+  /// Every following level takes the farthest depth of the 2x2 texels below it
+  hiz_downsample_shader_->use();
+  for (GLint level = 1; level < num_levels; ++level) {
+    width  = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glBindImageTexture(ImageBinding::HIZ_SOURCE,
+                       objects_.hiz_pyramid.id,
+                       level - 1,
+                       GL_FALSE,
+                       0,
+                       GL_READ_ONLY,
+                       GL_R32F);
+    glBindImageTexture(ImageBinding::HIZ_DESTINATION,
+                       objects_.hiz_pyramid.id,
+                       level,
+                       GL_FALSE,
+                       0,
+                       GL_WRITE_ONLY,
+                       GL_R32F);
+    glDispatchCompute((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                      (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                      1);
+  }
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
 void Renderer::framebufferSizeCallback(const int width, const int height) {
   Initializer::framebufferSizeCallback(width, height);
   createSceneFramebufferAttachments();
   camera_->updateAspectRatio(static_cast<float>(width) / static_cast<float>(height));
   camera_->updateProjectionMatrix();
-  glNamedBufferSubData(objects_.matrix_buffer.id,
-                       0,
-                       sizeof(glm::mat4),
-                       glm::value_ptr(camera_->getProjectionMatrix()));
+  const glm::vec2 screen_size {static_cast<float>(width), static_cast<float>(height)};
+  state_.frame_data.projection    = camera_->getProjectionMatrix();
+  state_.frame_data.viewport_size = screen_size;
+  if (config_.clustered_shading && temple_model_) { // otherwise the buffers are created later, with the new size
+    glNamedBufferSubData(objects_.cluster_buffer.id, 0, sizeof(glm::vec2), glm::value_ptr(screen_size));
+    state_.cluster_bounds_outdated = true; // the new projection only reaches the GPU with the next frame's data
+  }
 }
 
 void Renderer::cursorPosCallback(const float x_pos, const float y_pos) {
@@ -362,37 +1305,239 @@ void Renderer::scrollCallback(const float y_offset) {
   camera_->processMouseScroll(y_offset, state_.delta_time);
 }
 
-glm::mat4 Renderer::getSunlightMatrixForCascade(const float near_plane, const float far_plane) const {
+bool Renderer::getSampleDistributionBounds(const size_t cascade, glm::vec3& center, float& half_extent) const {
+  if (!state_.depth_reduction.valid) return false;
+  /// Undo the order-preserving encoding used by the reduction shader
+  const auto decode {[](const glm::uvec4& encoded) {
+    glm::vec3 decoded;
+    for (int c = 0; c < 3; ++c) {
+      decoded[c] = std::bit_cast<float>(encoded[c] & 0x80000000u ? encoded[c] & 0x7FFFFFFFu : ~encoded[c]);
+    }
+    return decoded;
+  }};
+  const DepthReduction& reduction {state_.depth_reduction.latest};
+  if (reduction.light_bounds_min[cascade].x > reduction.light_bounds_max[cascade].x) return false; // no samples
+  const glm::vec3 min_point {decode(reduction.light_bounds_min[cascade])};
+  const glm::vec3 max_point {decode(reduction.light_bounds_max[cascade])};
+
+  center = (min_point + max_point) / 2.0f;
+  // Round the size up to a quarter octave, so that the texel size (and with it shadow edges) does not change each frame
+  const float extent {glm::max(max_point.x - min_point.x, max_point.y - min_point.y) / 2.0f};
+  half_extent = std::exp2(std::ceil(std::log2(glm::max(extent, 1.0f / 16.0f)) * 4.0f) / 4.0f);
+  return true;
+}
+std::pair<glm::vec3, float> Renderer::getCascadeBoundingSphere(const float near_plane, const float far_plane) const {
   /// Compute partition projection matrix
   const glm::mat4 projection {glm::perspective(config_.camera_fov,
                                                static_cast<float>(config_.window_width)
                                                / static_cast<float>(config_.window_height),
                                                near_plane,
                                                far_plane)};
-  /// Compute light view matrix
+  /// Fit a sphere around the partition corners. Unlike a tight box, its size does not change as the camera rotates.
   const std::vector<glm::vec4> corners {getFrustumCorners(projection, camera_->getViewMatrix())};
   glm::vec3 frustum_center {0.0f};
   for (const glm::vec4& corner : corners) { frustum_center += glm::vec3(corner); }
   frustum_center /= std::ssize(corners);
-  const glm::mat4 light_view {glm::lookAt(frustum_center + glm::vec3(SUNLIGHT.source),
-                                          frustum_center,
-                                          glm::vec3(0.0f, 1.0f, 0.0f))};
-
-  /// Compute light projection matrix
-  float min_x {std::numeric_limits<float>::max()};
-  float min_y {std::numeric_limits<float>::max()};
-  float max_x {std::numeric_limits<float>::lowest()};
-  float max_y {std::numeric_limits<float>::lowest()};
+  float radius {0.0f};
   for (const glm::vec4& corner : corners) {
-    const glm::vec4 light_view_corner {light_view * corner};
-    min_x = glm::min(min_x, light_view_corner.x);
-    min_y = glm::min(min_y, light_view_corner.y);
-    max_x = glm::max(max_x, light_view_corner.x);
-    max_y = glm::max(max_y, light_view_corner.y);
-  }
-  const float& z_depth {config_.camera_far_plane};
-  const glm::mat4 light_projection {glm::ortho(min_x, max_x, min_y, max_y, -z_depth, z_depth)};
-  return light_projection * light_view;
+    radius = glm::max(radius, glm::distance(glm::vec3(corner), frustum_center));
+  }
+  radius = std::ceil(radius * 16.0f) / 16.0f; // round up, to absorb floating point noise between frames
+
+  const glm::vec4 light_space_center {getSunlightViewMatrix() * glm::vec4(frustum_center, 1.0f)};
+  return {glm::vec3(light_space_center), radius};
+}
+
+glm::mat4 Renderer::getSunlightMatrixForCascade(const glm::vec3& center, const float half_extent) const {
+  const float z_depth {half_extent + config_.camera_far_plane};
+  const glm::mat4 light_projection {glm::ortho(center.x - half_extent,
+                                               center.x + half_extent,
+                                               center.y - half_extent,
+                                               center.y + half_extent,
+                                               -center.z - z_depth,
+                                               -center.z + z_depth)};
+  return light_projection * getSunlightViewMatrix();
+}
+
+glm::mat4 Renderer::getSunlightViewMatrix() {
+  // Fixed origin, so that light space positions of static geometry never change
+  return glm::lookAt(glm::vec3(SUNLIGHT.source), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void Renderer::reportStatistics() {
+  std::string report {std::format("INFO (Renderer::reportStatistics): Shadow cascades refreshed: {} in {} frames.",
+                                  state_.csm_cascades_refreshed,
+                                  state_.frames_since_statistics_report)};
+  if (config_.occlusion_culling) {
+    OcclusionStatistics statistics;
+    glGetNamedBufferSubData(objects_.occlusion_statistics_buffer.id, 0, sizeof(statistics), &statistics);
+    report += std::format(" Last frame: {} draws, frustum culled: {}, early phase drew: {}, late phase occlusion "
+                          "culled: {}, drew: {}.",
+                          temple_model_->getNumDrawCommands(),
+                          statistics.frustum_culled,
+                          statistics.early_drawn,
+                          statistics.late_occluded,
+                          statistics.late_drawn);
+  }
+  if (config_.sparse_shadows) {
+    const GLsizei bytes_per_texel {config_.shadow_depth_format == GL_DEPTH_COMPONENT16 ? 2 : 4};
+    const ShadowPageState& pages {state_.shadow_pages};
+    report += std::format(" Resident shadow pages: {} of {} ({} MiB).",
+                          pages.committed_pages,
+                          pages.residency.size(),
+                          pages.committed_pages * pages.page_size_x * pages.page_size_y * bytes_per_texel >> 20);
+  }
+  const FrameTimings& timings {frame_timings_};
+  report += std::format(" Average frame ({} in flight): CPU {:.2f} ms, GPU {:.2f} ms, waiting {:.2f} ms.",
+                        config_.frames_in_flight,
+                        timings.cpu_ms / std::max(timings.cpu_frames, 1u),
+                        timings.gpu_ms / std::max(timings.gpu_frames, 1u),
+                        timings.wait_ms / std::max(timings.cpu_frames, 1u));
+  resetFrameTimings();
+  std::cout << report << std::endl;
+  state_.last_statistics_report_time   = state_.current_time;
+  state_.frames_since_statistics_report = 0;
+  state_.csm_cascades_refreshed        = 0;
+}
+
+CameraPath::Pose Renderer::getScriptedCameraPose() const {
+  if (benchmark_) return benchmark_->getPose();
+  if (golden_test_) return golden_test_->getPose();
+  return camera_replay_->getPose(camera_replay_->getFrameTime(state_.replay_frame));
+}
+
+CameraPath Renderer::getCameraPath(const std::string& name) const {
+  if (const auto path {config_.camera_paths.find(name)}; path != config_.camera_paths.end()) {
+    return CameraPath(path->second);
+  }
+  return CameraPath::loadRecording(name);
+}
+
+void Renderer::advanceBenchmark() {
+  const bool was_warming_up {benchmark_->isWarmingUp()};
+  benchmark_->endFrame();
+  if (was_warming_up && !benchmark_->isWarmingUp()) {
+    resetFrameTimings(); // so that only measured frames are averaged
+  } else if (benchmark_->isFinished()) {
+    reportBenchmarkResults();
+    glfwSetWindowShouldClose(window_, true);
+  }
+}
+
+void Renderer::reportBenchmarkResults() {
+  const Benchmark::Summary summary {benchmark_->summarize()};
+  const FrameTimings& timings {frame_timings_};
+  const std::string device {help::escapeJsonString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)))};
+  const std::string results {std::format(R"({{"device":"{}","width":{},"height":{},"headless":{},"frames":{},)"
+                                         R"("frame_ms":{{"mean":{:.4f},"p50":{:.4f},"p95":{:.4f},"p99":{:.4f},)"
+                                         R"("min":{:.4f},"max":{:.4f}}},)"
+                                         R"("fps":{{"mean":{:.2f},"one_percent_low":{:.2f}}},)"
+                                         R"("cpu_ms":{:.4f},"gpu_ms":{:.4f},"wait_ms":{:.4f}}})",
+                                         device,
+                                         config_.window_width,
+                                         config_.window_height,
+                                         config_.headless,
+                                         benchmark_->getMeasuredFrames(),
+                                         summary.mean,
+                                         summary.p50,
+                                         summary.p95,
+                                         summary.p99,
+                                         summary.min,
+                                         summary.max,
+                                         1000.0 / summary.mean,
+                                         summary.one_percent_low_fps,
+                                         timings.cpu_ms / std::max(timings.cpu_frames, 1u),
+                                         timings.gpu_ms / std::max(timings.gpu_frames, 1u),
+                                         timings.wait_ms / std::max(timings.cpu_frames, 1u))};
+  std::cout << results << std::endl;
+  if (config_.benchmark_output_path.empty()) return;
+  std::ofstream file {config_.benchmark_output_path};
+  file << results << '\n';
+  if (!file) {
+    std::cerr << std::format("WARNING (Renderer::reportBenchmarkResults): Failed to write '{}'.",
+                             config_.benchmark_output_path)
+              << std::endl;
+  }
+}
+
+void Renderer::advanceGoldenTest() {
+  if (!golden_test_->endFrame()) return;
+  golden_test_->checkImage(readOutputImage(), config_.window_width, config_.window_height);
+  if (golden_test_->isFinished()) {
+    reportGoldenTestResults();
+    glfwSetWindowShouldClose(window_, true);
+  }
+}
+
+std::vector<unsigned char> Renderer::readOutputImage() const {
+  const auto row_size {static_cast<size_t>(config_.window_width) * 3};
+  std::vector<unsigned char> pixels(row_size * config_.window_height);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  if (config_.headless) {
+    glGetTextureImage(objects_.output_fbo_color.id,
+                      0,
+                      GL_RGB,
+                      GL_UNSIGNED_BYTE,
+                      static_cast<GLsizei>(std::ssize(pixels)),
+                      pixels.data());
+  } else {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadPixels(0, 0, config_.window_width, config_.window_height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  /// OpenGL stores the bottom row first, image files the top row
+  for (size_t top = 0, bottom = config_.window_height - 1; top < bottom; ++top, --bottom) {
+    std::swap_ranges(pixels.begin() + static_cast<std::ptrdiff_t>(top * row_size),
+                     pixels.begin() + static_cast<std::ptrdiff_t>((top + 1) * row_size),
+                     pixels.begin() + static_cast<std::ptrdiff_t>(bottom * row_size));
+  }
+  return pixels;
+}
+
+void Renderer::reportGoldenTestResults() {
+  const std::string device {help::escapeJsonString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)))};
+  std::string views;
+  for (const GoldenImageTest::Result& result : golden_test_->getResults()) {
+    if (result.status != GoldenImageTest::PASSED) {
+      std::cerr << std::format("WARNING (Renderer::reportGoldenTestResults): View '{}' {}. {}",
+                               result.name,
+                               GoldenImageTest::getStatusName(result.status),
+                               result.error.empty()
+                                 ? std::format("PSNR {:.2f} dB, SSIM {:.4f}.", result.psnr, result.ssim)
+                                 : result.error)
+                << std::endl;
+    }
+    views += std::format(R"({}{{"name":"{}","status":"{}","psnr":{:.3f},"ssim":{:.5f},)"
+                         R"("frame_ms":{:.4f},"error":"{}"}})",
+                         views.empty() ? "" : ",",
+                         help::escapeJsonString(result.name),
+                         GoldenImageTest::getStatusName(result.status),
+                         result.psnr,
+                         result.ssim,
+                         result.frame_ms,
+                         help::escapeJsonString(result.error));
+  }
+  const std::string results {std::format(R"({{"device":"{}","width":{},"height":{},"headless":{},"updated":{},)"
+                                         R"("min_psnr":{},"min_ssim":{},"status":"{}","views":[{}]}})",
+                                         device,
+                                         config_.window_width,
+                                         config_.window_height,
+                                         config_.headless,
+                                         golden_test_->isUpdating(),
+                                         config_.golden_thresholds.min_psnr,
+                                         config_.golden_thresholds.min_ssim,
+                                         GoldenImageTest::getStatusName(golden_test_->getStatus()),
+                                         views)};
+  std::cout << results << std::endl;
+  if (config_.golden_output_path.empty()) return;
+  std::ofstream file {config_.golden_output_path};
+  file << results << '\n';
+  if (!file) {
+    std::cerr << std::format("WARNING (Renderer::reportGoldenTestResults): Failed to write '{}'.",
+                             config_.golden_output_path)
+              << std::endl;
+  }
 }
 
 std::vector<glm::vec4> Renderer::getFrustumCorners(const glm::mat4& projection, const glm::mat4& view) {
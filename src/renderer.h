@@ -8,11 +8,22 @@
 #include "skybox.h"
 #include "shader_program.h"
 #include "opengl_wrappers.h"
+#include "gpu_profiler.h"
+#include "benchmark.h"
+#include "camera_path.h"
+#include "golden_image_test.h"
 
 #include <glm/glm.hpp>
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <array>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <cstddef>
+#include <limits>
 
 struct RendererConfig : MinimalInitializerConfig {
   glm::vec3 initial_camera_pos;
@@ -24,44 +35,217 @@ struct RendererConfig : MinimalInitializerConfig {
   float camera_near_plane;
   float camera_far_plane;
   std::string model_source_path;
+  Model::LoadOptions model_load_options;
+  bool async_model_loading;
   std::string shader_source_path;
   bool debug_render_light_positions;
+  bool clustered_shading;
+  bool frustum_culling;
+  bool occlusion_culling;
+  bool cone_culling;
+  bool small_draw_culling;
+  float lod_pixel_error;
+  bool shadow_cache;
+  float shadow_cache_padding;
+  std::vector<GLuint> shadow_update_intervals;
+  GLsizei shadow_resolution;
+  GLsizei shadow_resident_resolution; // without sparse shadow maps
+  GLenum shadow_depth_format;
+  bool sparse_shadows;
+  bool sdsm;
+  bool report_statistics;
+  bool profile_gpu;
+  std::string profile_gpu_csv_path;
+  std::map<std::string, std::vector<CameraPath::Keyframe>> camera_paths;
+  std::string benchmark_path; // a key of camera_paths, or a file written by CameraRecorder
+  GLuint benchmark_warmup_frames;
+  std::string benchmark_output_path;
+  std::vector<GoldenImageTest::View> golden_views;
+  GLuint golden_frames_per_view;
+  std::string golden_directory;
+  GoldenImageTest::Thresholds golden_thresholds;
+  std::string golden_output_path;
+  bool golden_allow_missing;
 };
 
 /**
  * Implements the non-boilerplate methods declared by the abstract Initializer class.
  */
 class Renderer final : public Initializer<RendererConfig> {
+public:
+  enum RunMode {
+    INTERACTIVE,  // until the window is closed, with keyboard and mouse camera controls
+    RECORD,       // as INTERACTIVE, while writing the camera pose of every frame to camera_path (see CameraRecorder)
+    REPLAY,       // along camera_path, once
+    BENCHMARK,    // along the benchmark camera path, then prints frame time statistics as JSON (see Benchmark)
+    GOLDEN_TEST,  // at each golden image view, comparing the output against its golden image (see GoldenImageTest)
+    GOLDEN_UPDATE // at each golden image view, replacing its golden image with the output
+  };
+  /**
+   * @param camera_path     For RECORD, the file to write. For REPLAY, the name of a path in config.yaml, or a file
+   *                        written in RECORD mode.
+   */
+  explicit Renderer(const RunMode run_mode = INTERACTIVE, std::string camera_path = {})
+    : run_mode_ {run_mode}, camera_path_ {std::move(camera_path)} {}
+
+  /**
+   * @returns   Whether a golden image test ran, and any view failed. Valid once run() returns.
+   */
+  [[nodiscard]] bool hasFailed() const {
+    return golden_test_ && golden_test_->getStatus() == GoldenImageTest::FAILED;
+  }
+  /**
+   * @returns   Whether a golden image test ran, and no view failed, but some were skipped as they had no golden image
+   *            (see golden.allow_missing). Valid once run() returns.
+   */
+  [[nodiscard]] bool hasSkipped() const {
+    return golden_test_ && golden_test_->getStatus() == GoldenImageTest::SKIPPED;
+  }
+
+private:
+  struct ShadowCascade {
+    glm::mat4 light_matrix; // the matrix the cascade was last rendered with
+    glm::vec3 center;       // light space center of the rendered box
+    float half_extent;      // half the width of the rendered box
+    GLuint frames_since_update;
+    bool valid;
+    glm::ivec4 dirty_region; // texels (x, y, end x, end y) of sparse pages committed since the cascade was rendered
+  };
+  struct ShadowPageState {
+    GLint page_size_x;
+    GLint page_size_y;
+    GLint page_size_index;
+    GLint pages_x; // per cascade
+    GLint pages_y;
+    std::vector<GLuint> residency; // one flag per page, for all cascades
+    std::vector<GLuint> last_requested_frame; // SHADOW_PAGE_NEVER_REQUESTED until the page is first requested
+    GLuint frame;
+    GLint64 committed_pages;
+    std::array<GLsync, 2> readback_fences;
+    const GLuint* readback_data; // persistently mapped, two slots of residency.size() flags
+  };
+  struct DepthReduction { // this should match the definition in shaders/depth_reduce.comp
+    glm::mat4 view_to_sunlight_view;
+    GLuint min_view_depth;
+    GLuint max_view_depth;
+    GLuint padding[2]; // padding to conform with std430 storage layout rules
+    glm::uvec4 light_bounds_min[3];
+    glm::uvec4 light_bounds_max[3];
+  };
+  struct DepthReductionState {
+    std::array<GLsync, 2> readback_fences;
+    const DepthReduction* readback_data; // persistently mapped, two slots
+    GLuint frame;
+    bool valid; // whether latest holds a result yet
+    DepthReduction latest;
+  };
+  struct FrameData { // this should match the definition in shaders/ubo_frame.glsl
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 sunlight_transform[3];
+    GLuint csm_update_mask;
+    GLuint padding_0; // padding to conform with std140 layout rules
+    glm::vec2 viewport_size;
+    GLfloat lod_pixel_error;
+    GLfloat padding_1[3];
+    glm::vec4 camera_position;
+    glm::vec4 csm_partition_depths;
+  };
+  struct FrameDataRing {
+    std::byte* mapping;   // persistently mapped, one slot per fence
+    GLsizeiptr slot_size; // sizeof(FrameData), rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    std::array<GLsync, MAX_FRAMES_IN_FLIGHT> fences; // signalled once the GPU is done with the frame using the slot
+    GLuint frame;
+  };
+  /**
+   * The temple model is constructed on a worker thread, whose hidden window shares objects with the main context. It
+   * publishes the finished Model through finished, after flushing a fence that covers all of its uploads.
+   */
+  struct ModelLoadState {
+    GLFWwindow* context; // destroyed once the model is published
+    std::jthread thread;
+    std::atomic<float> progress;
+    std::atomic<bool> finished; // model, fence and error are written before this is set
+    std::unique_ptr<Model> model;
+    GLsync fence;
+    std::string error;
+    float start_time;
+    GLuint frames_while_loading;
+  };
   struct State {
     bool first_time_receiving_mouse_input;
     float mouse_x;
     float mouse_y;
     float current_time;
     float delta_time;
+    float last_statistics_report_time;
+    float last_profiler_report_time;
+    GLuint frames_since_statistics_report;
+    GLuint csm_cascades_refreshed;
+    GLuint csm_partial_update_mask; // cascades in frame_data.csm_update_mask that only render their dirty_region
+    GLuint replay_frame;
+    bool cluster_bounds_outdated;
+    FrameData frame_data; // assembled during each frame, and uploaded once by uploadFrameData()
+    FrameDataRing frame_data_ring;
+    std::vector<ShadowCascade> csm_cascades;
+    ShadowPageState shadow_pages;
+    DepthReductionState depth_reduction;
   };
   struct OpenGLObjects {
     wrap::VertexArray vao;
 
     wrap::Framebuffer scene_fbo;
     std::vector<std::unique_ptr<wrap::Texture>> scene_fbo_color;
-    wrap::Renderbuffer scene_fbo_depth;
+    wrap::Texture scene_fbo_depth;
+    wrap::Texture hiz_pyramid;
+
+    wrap::Framebuffer output_fbo; // replaces the default framebuffer when headless, which may not have one
+    wrap::Texture output_fbo_color;
 
     wrap::Framebuffer csm_fbo;
     wrap::Texture csm_fbo_depth;
 
-    wrap::Buffer matrix_buffer;
+    wrap::Buffer frame_data_buffer;
     wrap::Buffer light_data_buffer;
+    wrap::Buffer cluster_buffer;
+    wrap::Buffer cluster_light_index_buffer;
+    wrap::Buffer occlusion_statistics_buffer;
+    wrap::Buffer shadow_page_residency_buffer;
+    wrap::Buffer shadow_page_request_buffer;
+    wrap::Buffer shadow_page_readback_buffer;
+    wrap::Buffer depth_reduction_buffer;
+    wrap::Buffer depth_reduction_readback_buffer;
   };
+  RunMode run_mode_;
+  std::string camera_path_;
   State state_ {};
+  ModelLoadState model_load_ {};
   OpenGLObjects objects_ {};
   std::unique_ptr<Camera> camera_;
   std::unique_ptr<Model> temple_model_;
   std::unique_ptr<Skybox> skybox_;
   std::unique_ptr<ShaderProgram> csm_shader_;
+  std::unique_ptr<ShaderProgram> csm_cull_shader_;
   std::unique_ptr<ShaderProgram> temple_shader_;
   std::unique_ptr<ShaderProgram> skybox_shader_;
   std::unique_ptr<ShaderProgram> image_shader_;
   std::unique_ptr<ShaderProgram> debug_light_positions_shader_;
+  std::unique_ptr<ShaderProgram> cluster_bounds_shader_;
+  std::unique_ptr<ShaderProgram> light_frustum_cull_shader_;
+  std::unique_ptr<ShaderProgram> light_cluster_cull_shader_;
+  std::unique_ptr<ShaderProgram> frustum_cull_shader_;
+  std::unique_ptr<ShaderProgram> occlusion_cull_early_shader_;
+  std::unique_ptr<ShaderProgram> occlusion_cull_late_shader_;
+  std::unique_ptr<ShaderProgram> hiz_copy_shader_;
+  std::unique_ptr<ShaderProgram> hiz_downsample_shader_;
+  std::unique_ptr<ShaderProgram> depth_reduce_shader_;
+  std::unique_ptr<GpuProfiler> gpu_profiler_;
+  std::unique_ptr<Benchmark> benchmark_;
+  std::unique_ptr<CameraPath> camera_replay_;
+  std::unique_ptr<CameraRecorder> camera_recorder_;
+  std::unique_ptr<GoldenImageTest> golden_test_;
+  std::vector<std::pair<std::string, int>> shader_constants_;
+  size_t csm_draw_list_ {};
 
   /// Main program stages
   void loadConfigYaml() override;
@@ -72,11 +256,41 @@ class Renderer final : public Initializer<RendererConfig> {
   void renderTerminate() override;
 
   /// Sub-stages
-  void initializeMatrixBuffer();
+  void startModelLoad();
+  void loadTempleModel(); // runs on model_load_.thread
+  void pollModelLoad();   // calls templeSetup() once the loaded model is complete on the GPU
+  void templeSetup();     // everything that depends on temple_model_
+  void renderLoadingScreen();
+  void initializeFrameDataBuffer();
+  void uploadFrameData(); // waits until the oldest slot is free, then fills and binds it
+  void fenceFrameData();  // must be called after the last command reading the current slot
   void initializeLightDataBuffer();
   void createSceneFramebufferAttachments(); // may be called multiple times
+  void initializeOutputFramebuffer();
   void initializeCSMFramebuffer();
-  void renderSunlightCSM() const;
+  void updateSunlightCascades(); // must be called before uploadFrameData()
+  void renderSunlightCSM();
+  bool querySparseShadowPageSize(); // returns false if sparse shadow maps are not supported
+  void clampShadowResolution();     // to the limits of the texture, and for sparse ones to whole pages
+  void initializeShadowPageBuffers();
+  void updateShadowPageResidency();
+  void readBackShadowPageRequests();
+  void initializeDepthReductionBuffers();
+  void reduceSceneDepth(); // must be called after the scene depth buffer is complete
+  void readDepthReduction();
+  // Returns false (leaving center and half_extent unchanged) if last frame's reduction has no samples in the cascade
+  [[nodiscard]] bool getSampleDistributionBounds(size_t cascade, glm::vec3& center, float& half_extent) const;
+  void initializeClusterBuffers();
+  void updateClusterBounds(); // called by render() while cluster_bounds_outdated is set
+  void cullPointLights() const;
+  void renderTempleTwoPhaseOcclusion() const;
+  void buildHiZPyramid() const;
+  void reportStatistics();
+  void advanceBenchmark(); // closes the window once the benchmark is finished
+  void reportBenchmarkResults();
+  void advanceGoldenTest(); // closes the window once every view is checked
+  [[nodiscard]] std::vector<unsigned char> readOutputImage() const; // top row first, RGB
+  void reportGoldenTestResults();
 
   /// Callbacks
   void framebufferSizeCallback(int width, int height) override;
@@ -84,7 +298,13 @@ class Renderer final : public Initializer<RendererConfig> {
   void scrollCallback(float y_offset) override;
 
   /// Helper methods
-  [[nodiscard]] glm::mat4 getSunlightMatrixForCascade(float near_plane, float far_plane) const;
+  [[nodiscard]] std::pair<glm::vec3, float> getCascadeBoundingSphere(float near_plane, float far_plane) const;
+  [[nodiscard]] glm::mat4 getSunlightMatrixForCascade(const glm::vec3& center, float half_extent) const;
+  [[nodiscard]] bool isCameraScripted() const { return benchmark_ || camera_replay_ || golden_test_; }
+  [[nodiscard]] CameraPath::Pose getScriptedCameraPose() const;
+  [[nodiscard]] CameraPath getCameraPath(const std::string& name) const; // a key of camera_paths, or a recording
+  [[nodiscard]] GLuint getOutputFramebuffer() const { return config_.headless ? objects_.output_fbo.id : 0; }
+  [[nodiscard]] static glm::mat4 getSunlightViewMatrix();
   [[nodiscard]] static std::vector<glm::vec4> getFrustumCorners(const glm::mat4& projection, const glm::mat4& view);
   static void checkFramebufferErrors(const wrap::Framebuffer& framebuffer);
 
@@ -101,26 +321,115 @@ class Renderer final : public Initializer<RendererConfig> {
   static constexpr Light DEFAULT_POINT_LIGHT {{0.0f, 0.0f, 0.0f, 1.0f},
                                               {0.6f, 1.0f, 0.9f, 1.0f},
                                               0.05f};
-  static constexpr GLsizei CSM_TEX_SIZE {16192};
   static constexpr size_t CSM_NUM_CASCADES {3};
+  static constexpr GLuint SHADOW_PAGE_EVICTION_FRAMES {60}; // unrequested sparse pages are released after this
+  static constexpr GLuint SHADOW_PAGE_NEVER_REQUESTED {std::numeric_limits<GLuint>::max()};
+  static constexpr GLuint DEPTH_REDUCE_GROUP_SIZE {16};
 
   static constexpr size_t SCENE_FBO_NUM_COLOR_ATTACHMENTS {2};
   static constexpr size_t SCENE_FBO_COLOR_INDEX_TEMPLE {0};
   static constexpr size_t SCENE_FBO_COLOR_INDEX_SKY {1};
 
-  enum TextureBinding { TEMPLE_ARRAY, SUN_CSM_ARRAY, SKY_CUBE_MAP, SCENE_TEMPLE, SCENE_SKY };
-  enum SSBOBinding { TEMPLE_VERTEX, SKY_VERTEX, LIGHT_DATA };
-  enum UBOBinding { MATRIX };
+  /// Clustered shading. The cluster buffer holds a header (screen size, near/far planes, visible light and light index
+  /// counters), followed by CLUSTER_COUNT clusters, followed by the compacted list of lights in the view frustum.
+  static constexpr GLuint CLUSTER_GRID_X {16};
+  static constexpr GLuint CLUSTER_GRID_Y {9};
+  static constexpr GLuint CLUSTER_GRID_Z {24};
+  static constexpr GLuint CLUSTER_COUNT {CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z};
+  static constexpr GLuint CLUSTER_MAX_LIGHTS {128}; // lights beyond this are dropped from the cluster
+  static constexpr GLuint CLUSTER_GROUP_SIZE {128};
+  static constexpr GLuint LIGHT_CULL_GROUP_SIZE {64};
+  static constexpr GLsizeiptr CLUSTER_BUFFER_HEADER_SIZE {2 * sizeof(glm::vec4)};
+  static constexpr GLsizeiptr CLUSTER_SIZE {3 * sizeof(glm::vec4)};
+  static constexpr GLsizeiptr VISIBLE_LIGHT_SIZE {sizeof(glm::vec4)};
+
+  /// Occlusion culling
+  struct OcclusionStatistics {
+    GLuint frustum_culled; // includes draws removed by cone and small draw culling
+    GLuint early_drawn;
+    GLuint late_occluded;
+    GLuint late_drawn;
+  };
+  static constexpr GLuint HIZ_GROUP_SIZE {8};
+
+  enum TextureBinding {
+    TEMPLE_DIFFUSE_ARRAY,
+    TEMPLE_NORMAL_ARRAY,
+    TEMPLE_SPECULAR_ARRAY,
+    SUN_CSM_ARRAY,
+    SKY_CUBE_MAP,
+    SCENE_TEMPLE,
+    SCENE_SKY,
+    SCENE_DEPTH,
+    HIZ_PYRAMID
+  };
+  enum ImageBinding { HIZ_SOURCE, HIZ_DESTINATION };
+  enum SSBOBinding {
+    TEMPLE_VERTEX,
+    SKY_VERTEX,
+    LIGHT_DATA,
+    CLUSTER,
+    CLUSTER_LIGHT_INDEX,
+    DRAW_BOUNDS,
+    DRAW_CONE,
+    DRAW_LOD,
+    DRAW_COMMAND,
+    CULLED_DRAW_COMMAND,
+    DRAW_COUNT,
+    DRAW_VISIBILITY,
+    OCCLUSION_STATISTICS,
+    SHADOW_PAGE_RESIDENCY,
+    SHADOW_PAGE_REQUEST,
+    DEPTH_REDUCTION
+  };
+  enum UBOBinding { FRAME };
+  enum ProfiledPass { SUNLIGHT_CSM_PASS, LIGHT_CULLING_PASS, TEMPLE_PASS, SKY_PASS, COMPOSITE_PASS };
+  inline static const std::vector<std::string> PROFILED_PASS_NAMES {"sunlight_csm",
+                                                                    "light_culling",
+                                                                    "temple",
+                                                                    "sky",
+                                                                    "composite"};
   inline static const std::vector<std::pair<std::string, int>> SHADER_CONSTANTS {{
-    std::make_pair("SAMPLER_ARRAY_TEMPLE", TEMPLE_ARRAY),
+    std::make_pair("SAMPLER_ARRAY_TEMPLE_DIFFUSE", TEMPLE_DIFFUSE_ARRAY),
+    std::make_pair("SAMPLER_ARRAY_TEMPLE_NORMAL", TEMPLE_NORMAL_ARRAY),
+    std::make_pair("SAMPLER_ARRAY_TEMPLE_SPECULAR", TEMPLE_SPECULAR_ARRAY),
     std::make_pair("SAMPLER_ARRAY_SHADOW_SUN", SUN_CSM_ARRAY),
     std::make_pair("SAMPLER_CUBE_SKY", SKY_CUBE_MAP),
     std::make_pair("SAMPLER_SCENE_MODEL", SCENE_TEMPLE),
     std::make_pair("SAMPLER_SCENE_SKY", SCENE_SKY),
+    std::make_pair("SAMPLER_SCENE_DEPTH", SCENE_DEPTH),
+    std::make_pair("SAMPLER_HIZ_PYRAMID", HIZ_PYRAMID),
+    std::make_pair("IMAGE_HIZ_SOURCE", HIZ_SOURCE),
+    std::make_pair("IMAGE_HIZ_DESTINATION", HIZ_DESTINATION),
     std::make_pair("SSBO_TEMPLE_VERTEX", TEMPLE_VERTEX),
     std::make_pair("SSBO_SKY_VERTEX", SKY_VERTEX),
     std::make_pair("SSBO_LIGHT_DATA", LIGHT_DATA),
-    std::make_pair("UBO_MATRIX", MATRIX),
+    std::make_pair("SSBO_CLUSTER", CLUSTER),
+    std::make_pair("SSBO_CLUSTER_LIGHT_INDEX", CLUSTER_LIGHT_INDEX),
+    std::make_pair("SSBO_DRAW_BOUNDS", DRAW_BOUNDS),
+    std::make_pair("SSBO_DRAW_CONE", DRAW_CONE),
+    std::make_pair("SSBO_DRAW_LOD", DRAW_LOD),
+    std::make_pair("SSBO_DRAW_COMMAND", DRAW_COMMAND),
+    std::make_pair("SSBO_CULLED_DRAW_COMMAND", CULLED_DRAW_COMMAND),
+    std::make_pair("SSBO_DRAW_COUNT", DRAW_COUNT),
+    std::make_pair("SSBO_DRAW_VISIBILITY", DRAW_VISIBILITY),
+    std::make_pair("SSBO_OCCLUSION_STATISTICS", OCCLUSION_STATISTICS),
+    std::make_pair("SSBO_SHADOW_PAGE_RESIDENCY", SHADOW_PAGE_RESIDENCY),
+    std::make_pair("SSBO_SHADOW_PAGE_REQUEST", SHADOW_PAGE_REQUEST),
+    std::make_pair("SSBO_DEPTH_REDUCTION", DEPTH_REDUCTION),
+    std::make_pair("UBO_FRAME", FRAME),
+    std::make_pair("CLUSTER_GRID_X", CLUSTER_GRID_X),
+    std::make_pair("CLUSTER_GRID_Y", CLUSTER_GRID_Y),
+    std::make_pair("CLUSTER_GRID_Z", CLUSTER_GRID_Z),
+    std::make_pair("CLUSTER_COUNT", CLUSTER_COUNT),
+    std::make_pair("CLUSTER_MAX_LIGHTS", CLUSTER_MAX_LIGHTS),
+    std::make_pair("CLUSTER_GROUP_SIZE", CLUSTER_GROUP_SIZE),
+    std::make_pair("LIGHT_CULL_GROUP_SIZE", LIGHT_CULL_GROUP_SIZE),
+    std::make_pair("DRAW_CULL_GROUP_SIZE", Model::CULL_GROUP_SIZE),
+    std::make_pair("DRAW_LOD_MAX_LEVELS", Model::MAX_LOD_LEVELS),
+    std::make_pair("HIZ_GROUP_SIZE", HIZ_GROUP_SIZE),
+    std::make_pair("DEPTH_REDUCE_GROUP_SIZE", DEPTH_REDUCE_GROUP_SIZE),
+    std::make_pair("CSM_NUM_CASCADES", CSM_NUM_CASCADES),
   }};
 };
 #endif //TEMPLEGL_SRC_RENDERER_H_
@@ -1,4 +1,5 @@
 #include "shader_program.h"
+#include "cpu_profiler.h"
 
 #include <fstream>
 #include <format>
@@ -78,6 +79,7 @@ std::string ShaderProgram::Stages::handleInclude(const std::string& include_line
 }
 
 ShaderProgram::ShaderProgram(const Stages& stages) {
+  PROFILE_ZONE("ShaderProgram::ShaderProgram");
   program_id_ = glCreateProgram();
   const std::array shader_ids {
     compileShader(stages.vertex_shader_source_, GL_VERTEX_SHADER),
@@ -1,13 +1,25 @@
 #include "skybox.h"
 #include "stbi_helpers.h"
+#include "cpu_profiler.h"
 
-Skybox::Skybox(const std::vector<std::string>& paths) {
+Skybox::Skybox(const std::vector<std::string>& paths, const bool compressed_textures) {
+  PROFILE_ZONE("Skybox::Skybox");
   glCreateBuffers(1, &vertex_buffer_.id);
   glNamedBufferStorage(vertex_buffer_.id, sizeof(VERTICES), VERTICES.data(), 0);
 
   glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &cube_map_.id);
-  glTextureStorage2D(cube_map_.id, 1, GL_SRGB8, FACE_SIZE, FACE_SIZE);
-  for (int i = 0; i < 6; ++i) { help::fill3DTextureLayer(paths[i], cube_map_, i, FACE_SIZE, FACE_SIZE); }
+  const std::span face_paths {std::span {paths}.first(6)};
+  if (compressed_textures) {
+    std::vector<std::string> baked_paths;
+    for (const std::string& path : face_paths) { baked_paths.push_back(help::getCompressedTexturePath(path)); }
+    help::bakeCompressedTextures(face_paths, {}, baked_paths, help::BC1_SRGB, FACE_SIZE, FACE_SIZE, 1,
+                                 help::MIP_FILTER_COLOR);
+    glTextureStorage2D(cube_map_.id, 1, help::getBlockFormatInternalFormat(help::BC1_SRGB), FACE_SIZE, FACE_SIZE);
+    help::fill3DTextureLayersCompressed(baked_paths, cube_map_, 0, FACE_SIZE, FACE_SIZE, 1, help::BC1_SRGB);
+  } else {
+    glTextureStorage2D(cube_map_.id, 1, GL_SRGB8, FACE_SIZE, FACE_SIZE);
+    help::fill3DTextureLayers(face_paths, {}, cube_map_, 0, FACE_SIZE, FACE_SIZE, 1, help::MIP_FILTER_COLOR);
+  }
   glTextureParameteri(cube_map_.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTextureParameteri(cube_map_.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTextureParameteri(cube_map_.id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
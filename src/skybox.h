@@ -3,6 +3,7 @@
 
 #include "opengl_wrappers.h"
 #include "shader_program.h"
+#include "texture_compression_helpers.h"
 
 #include <vector>
 #include <string>
@@ -16,8 +17,10 @@ public:
    *
    * @param paths   List of paths to the 6 faces of a cube map, in +X, -X, +Y, -Y, +Z, -Z order. The textures should be
    *                512x512, in RGB or RGBA format (4th channel will be ignored).
+   * @param compressed_textures If true, the faces are baked to BC1 KTX2 files next to them (when missing or older than
+   *                            the image), and loaded from there.
    */
-  explicit Skybox(const std::vector<std::string>& paths);
+  Skybox(const std::vector<std::string>& paths, bool compressed_textures);
 
   /**
    * Binds GL_SHADER_STORAGE_BUFFER at vertex_buffer_binding. Binds cube_map_ to unit specified by texture_binding.
@@ -1,57 +1,217 @@
 #include "stbi_helpers.h"
+#include "parallel_helpers.h"
+#include "cpu_profiler.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
 #include <glad/glad.h>
 
 #include <format>
 #include <memory>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
 
 struct StbiDeleter {
   void operator()(unsigned char* data) const { stbi_image_free(data); }
 };
 
-void help::fill3DTextureLayer(const std::string& path,
-                              const wrap::Texture& texture,
-                              const GLint layer,
-                              const GLsizei width,
-                              const GLsizei height) {
+/**
+ * Decodes an image file (or two, see loadImage) on a worker thread. Errors are reported afterwards, since only the
+ * thread owning the OpenGL context may insert debug messages.
+ */
+struct DecodeResult {
+  std::string error;
+  double milliseconds;
+};
+
+/**
+ * Decodes one RGB file into pixels, checking its dimensions.
+ *
+ * @returns   An error message, or an empty string on success.
+ */
+static std::string loadRgbImage(const std::string& path,
+                                const GLsizei width,
+                                const GLsizei height,
+                                std::unique_ptr<unsigned char, StbiDeleter>& pixels) {
   int actual_width, actual_height, actual_num_components;
-  const auto data {std::unique_ptr<unsigned char, StbiDeleter>(stbi_load(path.c_str(),
-                                                                         &actual_width,
-                                                                         &actual_height,
-                                                                         &actual_num_components,
-                                                                         STBI_rgb),
-                                                               StbiDeleter())};
-  if (!data) {
-    glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
-                         GL_DEBUG_TYPE_ERROR,
-                         0,
-                         GL_DEBUG_SEVERITY_MEDIUM,
-                         -1,
-                         std::format("(help::fill3DTextureLayer): Failed to read file from path '{}.'",
-                                     path).c_str());
+  pixels = std::unique_ptr<unsigned char, StbiDeleter>(stbi_load(path.c_str(),
+                                                                 &actual_width,
+                                                                 &actual_height,
+                                                                 &actual_num_components,
+                                                                 STBI_rgb),
+                                                       StbiDeleter());
+  if (!pixels) {
+    return std::format("Failed to read file from path '{}.'", path);
   } else if (actual_width != width || actual_height != height) {
+    return std::format("Texture '{}' does not have required dimensions ({}x{}).", path, width, height);
+  } else if (actual_num_components < 3) {
+    return std::format("Texture '{}' does not have required number of channels (>=3).", path);
+  }
+  return {};
+}
+
+std::string help::loadImage(const std::string& path,
+                            const std::string& alpha_path,
+                            const GLsizei width,
+                            const GLsizei height,
+                            std::vector<unsigned char>& pixels) {
+  std::unique_ptr<unsigned char, StbiDeleter> rgb;
+  if (std::string error {loadRgbImage(path, width, height, rgb)}; !error.empty()) return error;
+  const auto num_texels {static_cast<size_t>(width) * height};
+  if (alpha_path.empty()) {
+    pixels.assign(rgb.get(), rgb.get() + num_texels * 3);
+    return {};
+  }
+  std::unique_ptr<unsigned char, StbiDeleter> alpha;
+  if (std::string error {loadRgbImage(alpha_path, width, height, alpha)}; !error.empty()) return error;
+  pixels.resize(num_texels * 4);
+  for (size_t i = 0; i < num_texels; ++i) {
+    std::memcpy(&pixels[i * 4], rgb.get() + i * 3, 3);
+    pixels[i * 4 + 3] = alpha.get()[i * 3];
+  }
+  return {};
+}
+
+bool help::writeImage(const std::string& path,
+                      const GLsizei width,
+                      const GLsizei height,
+                      const std::span<const unsigned char> pixels) {
+  return stbi_write_png(path.c_str(), width, height, 3, pixels.data(), width * 3) != 0;
+}
+
+/**
+ * Decodes a layer and writes its mip chain (see generateMipLevels) to destination, level after level.
+ */
+static DecodeResult decodeLayer(const std::string& path,
+                                const std::string& alpha_path,
+                                unsigned char* destination,
+                                const GLsizei width,
+                                const GLsizei height,
+                                const GLsizei num_levels,
+                                const help::MipFilter filter) {
+  PROFILE_ZONE("decodeLayer");
+  const auto start_time {std::chrono::steady_clock::now()};
+  std::vector<unsigned char> pixels;
+  std::string error {help::loadImage(path, alpha_path, width, height, pixels)};
+  if (error.empty()) {
+    for (const std::vector<unsigned char>& level : help::generateMipLevels(pixels.data(),
+                                                                         width,
+                                                                         height,
+                                                                         alpha_path.empty() ? 3 : 4,
+                                                                         num_levels,
+                                                                         filter)) {
+      std::memcpy(destination, level.data(), level.size());
+      destination += level.size();
+    }
+  }
+  return {std::move(error),
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count()};
+}
+
+void help::fill3DTextureLayers(const std::span<const std::string> paths,
+                               const std::span<const std::string> alpha_paths,
+                               const wrap::Texture& texture,
+                               const GLint first_layer,
+                               const GLsizei width,
+                               const GLsizei height,
+                               const GLsizei num_levels,
+                               const MipFilter filter) {
+  PROFILE_ZONE("help::fill3DTextureLayers");
+  if (paths.empty()) return;
+  const auto start_time {std::chrono::steady_clock::now()};
+
+  /// Map a staging buffer that holds every level of every layer, and let the workers decode straight into it
+  const size_t num_channels {alpha_paths.empty() ? 3u : 4u};
+  std::vector<size_t> level_offsets;
+  size_t layer_size {0};
+  for (GLsizei level = 0; level < num_levels; ++level) {
+    level_offsets.push_back(layer_size);
+    layer_size += static_cast<size_t>(std::max(width >> level, 1)) * std::max(height >> level, 1) * num_channels;
+  }
+  const auto staging_size {static_cast<GLsizeiptr>(layer_size * paths.size())};
+  wrap::Buffer staging_buffer {};
+  glCreateBuffers(1, &staging_buffer.id);
+  glNamedBufferStorage(staging_buffer.id, staging_size, nullptr, GL_MAP_WRITE_BIT);
+  auto* staging {static_cast<unsigned char*>(glMapNamedBufferRange(staging_buffer.id,
+                                                                   0,
+                                                                   staging_size,
+                                                                   GL_MAP_WRITE_BIT
+                                                                   | GL_MAP_INVALIDATE_BUFFER_BIT
+                                                                   | GL_MAP_UNSYNCHRONIZED_BIT))};
+  if (!staging) {
     glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
                          GL_DEBUG_TYPE_ERROR,
-                         0,
-                         GL_DEBUG_SEVERITY_MEDIUM,
+                         staging_buffer.id,
+                         GL_DEBUG_SEVERITY_HIGH,
                          -1,
-                         std::format("(help::fill3DTextureLayer): Texture '{}' does not have required dimensions "
-                                     "({}x{}).",
-                                     path,
-                                     width,
-                                     height).c_str());
-  } else if (actual_num_components < 3) {
+                         "(help::fill3DTextureLayers): Failed to map staging buffer.");
+    return;
+  }
+
+  std::vector<DecodeResult> results(paths.size());
+  help::parallelFor(paths.size(), [&](const size_t i) {
+    const std::string& alpha_path {alpha_paths.empty() ? std::string {} : alpha_paths[i]};
+    results[i] = decodeLayer(paths[i], alpha_path, staging + i * layer_size, width, height, num_levels, filter);
+  });
+  const auto decode_end_time {std::chrono::steady_clock::now()};
+  glUnmapNamedBuffer(staging_buffer.id);
+
+  /// Upload every decoded layer from the staging buffer, and report the files that could not be used
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging_buffer.id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // rows of the smallest levels are not 4-byte aligned
+  double total_decode_time {0.0};
+  for (size_t i = 0; i < paths.size(); ++i) {
+    const DecodeResult& result {results[i]};
+    total_decode_time += result.milliseconds;
+    if (!result.error.empty()) {
+      glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                           GL_DEBUG_TYPE_ERROR,
+                           0,
+                           GL_DEBUG_SEVERITY_MEDIUM,
+                           -1,
+                           ("(help::fill3DTextureLayers): " + result.error).c_str());
+      continue;
+    }
+    for (GLsizei level = 0; level < num_levels; ++level) {
+      glTextureSubImage3D(texture.id,
+                          level,
+                          0,
+                          0,
+                          first_layer + static_cast<GLint>(i),
+                          std::max(width >> level, 1),
+                          std::max(height >> level, 1),
+                          1,
+                          num_channels == 4 ? GL_RGBA : GL_RGB,
+                          GL_UNSIGNED_BYTE,
+                          reinterpret_cast<const void*>(i * layer_size + level_offsets[level]));
+    }
     glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
-                         GL_DEBUG_TYPE_ERROR,
-                         0,
-                         GL_DEBUG_SEVERITY_MEDIUM,
+                         GL_DEBUG_TYPE_OTHER,
+                         texture.id,
+                         GL_DEBUG_SEVERITY_NOTIFICATION,
                          -1,
-                         std::format("(help::fill3DTextureLayer): Texture '{}' does not have required number of "
-                                     "channels (>=3).",
-                                     path).c_str());
-  } else {
-    glTextureSubImage3D(texture.id, 0, 0, 0, layer, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, data.get());
+                         std::format("(help::fill3DTextureLayers): Decoded '{}' in {:.2f} ms.",
+                                     paths[i],
+                                     result.milliseconds).c_str());
   }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  const auto end_time {std::chrono::steady_clock::now()};
+  const auto slowest {std::ranges::max_element(results, {}, &DecodeResult::milliseconds)};
+  std::cout << std::format("INFO (help::fill3DTextureLayers): Loaded {} images in {:.1f} ms (decode {:.1f} ms, "
+                           "upload {:.1f} ms). Summed decode time {:.1f} ms, slowest '{}' at {:.1f} ms.",
+                           paths.size(),
+                           std::chrono::duration<double, std::milli>(end_time - start_time).count(),
+                           std::chrono::duration<double, std::milli>(decode_end_time - start_time).count(),
+                           std::chrono::duration<double, std::milli>(end_time - decode_end_time).count(),
+                           total_decode_time,
+                           paths[slowest - results.begin()],
+                           slowest->milliseconds)
+            << std::endl;
 }
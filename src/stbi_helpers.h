@@ -2,27 +2,67 @@
 #define TEMPLEGL_SRC_STBI_HELPERS_H_
 
 #include "opengl_wrappers.h"
+#include "mipmap_helpers.h"
 
 #include <string>
+#include <span>
+#include <vector>
 
 /**
- * Collects helper functions that deal with the stb_image library, which we use for loading textures from files.
+ * Collects helper functions that deal with the stb_image library, which we use for loading textures from files, and
+ * stb_image_write, which we use for saving rendered images.
  */
 namespace help {
   /**
-   * Loads an image file and passes it to glTextureSubImage3D.
+   * Decodes an RGB or RGBA image file (4th channel will be ignored). If alpha_path is not empty, the red channel of
+   * that file is added as a 4th channel. Safe to call from any thread.
    *
-   * @param path    Path to the image file. Should be RGB or RGBA (although 4th channel will be ignored), with width
-   *                and height matching the 3rd and 4th arguments. Otherwise, no data will be loaded.
-   * @param texture The 3D texture in which data should be placed.
-   * @param layer   The layer (z_offset) which should be filled.
-   * @param width   The width of the texture in pixels.
-   * @param height  The height of the texture in pixels.
+   * @param pixels  Receives width * height texels, with 3 (or 4) tightly packed channels each.
+   *
+   * @returns   A description of the problem if a file could not be read or does not match the given dimensions, or an
+   *            empty string on success.
+   */
+  [[nodiscard]] std::string loadImage(const std::string& path,
+                                      const std::string& alpha_path,
+                                      GLsizei width,
+                                      GLsizei height,
+                                      std::vector<unsigned char>& pixels);
+
+  /**
+   * Encodes an RGB image as a PNG file.
+   *
+   * @param pixels  width * height texels with 3 tightly packed channels each, starting with the top row.
+   *
+   * @returns   Whether the file was written successfully.
+   */
+  bool writeImage(const std::string& path, GLsizei width, GLsizei height, std::span<const unsigned char> pixels);
+
+  /**
+   * Loads a list of image files, builds their mip chains, and uploads them to consecutive layers of a 3D texture (or
+   * cube map).
+   * <p>
+   * The files are decoded in parallel (see parallelFor), straight into a mapped pixel unpack buffer. Once all of them
+   * are done, the calling thread uploads every layer from that buffer. Per-file decode times are sent as debug
+   * messages, and a summary is printed to stdout.
+   *
+   * @param paths       Paths to the image files. Should be RGB or RGBA (although 4th channel will be ignored), with
+   *                    width and height matching the 5th and 6th arguments. Otherwise, the layer is left unfilled.
+   * @param alpha_paths Either empty, or one path per layer whose red channel becomes the alpha channel of the layer
+   *                    (see loadImage). RGBA data is uploaded in that case, and RGB data otherwise.
+   * @param texture     The 3D texture in which data should be placed.
+   * @param first_layer The layer (z_offset) which should be filled with the first image.
+   * @param width       The width of the texture in pixels.
+   * @param height      The height of the texture in pixels.
+   * @param num_levels  The number of mip levels to fill (at most the number the texture was allocated with).
+   * @param filter      How the mip levels are built, see generateMipLevels().
    */
-  void fill3DTextureLayer(const std::string& path,
-                          const wrap::Texture& texture,
-                          GLint layer,
-                          GLsizei width,
-                          GLsizei height);
+  void fill3DTextureLayers(std::span<const std::string> paths,
+                           std::span<const std::string> alpha_paths,
+                           const wrap::Texture& texture,
+                           GLint first_layer,
+                           GLsizei width,
+                           GLsizei height,
+                           GLsizei num_levels,
+                           MipFilter filter);
 }
 #endif //TEMPLEGL_SRC_STBI_HELPERS_H_
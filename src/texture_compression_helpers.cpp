@@ -0,0 +1,478 @@
+#include "texture_compression_helpers.h"
+#include "parallel_helpers.h"
+#include "file_helpers.h"
+#include "mipmap_helpers.h"
+#include "stbi_helpers.h"
+#include "cpu_profiler.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+/**
+ * The fixed part of a KTX2 file, followed by one Ktx2LevelIndex per mip level. See the KTX 2.0 specification.
+ */
+struct Ktx2Header {
+  std::uint8_t identifier[12];
+  std::uint32_t vk_format;
+  std::uint32_t type_size;
+  std::uint32_t pixel_width;
+  std::uint32_t pixel_height;
+  std::uint32_t pixel_depth;
+  std::uint32_t layer_count;
+  std::uint32_t face_count;
+  std::uint32_t level_count;
+  std::uint32_t supercompression_scheme;
+  std::uint32_t dfd_byte_offset;
+  std::uint32_t dfd_byte_length;
+  std::uint32_t kvd_byte_offset;
+  std::uint32_t kvd_byte_length;
+  std::uint64_t sgd_byte_offset;
+  std::uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+struct Ktx2LevelIndex {
+  std::uint64_t byte_offset;
+  std::uint64_t byte_length;
+  std::uint64_t uncompressed_byte_length;
+};
+static constexpr std::array<std::uint8_t, 12> KTX2_IDENTIFIER {
+  0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+struct BlockFormatInfo {
+  GLenum internal_format;
+  std::uint32_t vk_format;
+  std::uint8_t dfd_color_model;    // KHR_DF_MODEL_BC1A, KHR_DF_MODEL_BC4 or KHR_DF_MODEL_BC5
+  std::uint8_t dfd_transfer;       // KHR_DF_TRANSFER_LINEAR or KHR_DF_TRANSFER_SRGB
+  std::uint32_t block_size;        // in bytes
+  std::uint32_t num_channels;       // number of 64-bit blocks in every 4x4 texel block
+};
+
+static BlockFormatInfo getBlockFormatInfo(const help::BlockFormat format) {
+  switch (format) {
+    case help::BC1_RGB:  return {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 131, 128, 1, 8, 1};
+    case help::BC1_SRGB: return {GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 132, 128, 2, 8, 1};
+    case help::BC4_R:    return {GL_COMPRESSED_RED_RGTC1, 139, 131, 1, 8, 1};
+    case help::BC3_RGBA: return {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 137, 130, 1, 16, 2};
+    case help::BC5_RG:   return {GL_COMPRESSED_RG_RGTC2, 141, 132, 1, 16, 2};
+  }
+  return {};
+}
+
+GLenum help::getBlockFormatInternalFormat(const BlockFormat format) {
+  return getBlockFormatInfo(format).internal_format;
+}
+
+size_t help::getCompressedImageSize(const BlockFormat format, const GLsizei width, const GLsizei height) {
+  const auto blocks_x {static_cast<size_t>((width + 3) / 4)};
+  const auto blocks_y {static_cast<size_t>((height + 3) / 4)};
+  return blocks_x * blocks_y * getBlockFormatInfo(format).block_size;
+}
+
+static std::uint16_t packRgb565(const glm::vec3& color) {
+  const glm::vec3 scaled {glm::round(glm::clamp(color, 0.0f, 255.0f) * glm::vec3(31.0f, 63.0f, 31.0f) / 255.0f)};
+  return static_cast<std::uint16_t>(static_cast<unsigned>(scaled.x) << 11
+                                    | static_cast<unsigned>(scaled.y) << 5
+                                    | static_cast<unsigned>(scaled.z));
+}
+
+static glm::vec3 unpackRgb565(const std::uint16_t color) {
+  const unsigned r {color >> 11 & 31u};
+  const unsigned g {color >> 5 & 63u};
+  const unsigned b {color & 31u};
+  return {static_cast<float>(r << 3 | r >> 2),
+          static_cast<float>(g << 2 | g >> 4),
+          static_cast<float>(b << 3 | b >> 2)};
+}
+
+/**
+ * Picks the closest of the four BC1 palette entries for every texel.
+ *
+ * @returns   The summed squared error.
+ */
+static float chooseBC1Indices(const std::array<glm::vec3, 16>& texels,
+                              const std::uint16_t color_0,
+                              const std::uint16_t color_1,
+                              std::array<std::uint32_t, 16>& indices) {
+  const glm::vec3 end_0 {unpackRgb565(color_0)};
+  const glm::vec3 end_1 {unpackRgb565(color_1)};
+  const std::array<glm::vec3, 4> palette {end_0, end_1, (2.0f * end_0 + end_1) / 3.0f, (end_0 + 2.0f * end_1) / 3.0f};
+  float error {0.0f};
+  for (size_t i = 0; i < texels.size(); ++i) {
+    float best_distance {std::numeric_limits<float>::max()};
+    for (std::uint32_t j = 0; j < palette.size(); ++j) {
+      const glm::vec3 difference {texels[i] - palette[j]};
+      const float distance {glm::dot(difference, difference)};
+      if (distance < best_distance) {
+        best_distance = distance;
+        indices[i]    = j;
+      }
+    }
+    error += best_distance;
+  }
+  return error;
+}
+
+static void encodeBC1Block(const std::array<glm::vec3, 16>& texels, std::byte* destination) {
+  /// Start with the extremes of the block along its principal axis (found by power iteration on the covariance)
+  glm::vec3 mean {0.0f};
+  for (const glm::vec3& texel : texels) { mean += texel / 16.0f; }
+  glm::mat3 covariance {0.0f};
+  for (const glm::vec3& texel : texels) { covariance += glm::outerProduct(texel - mean, texel - mean); }
+  glm::vec3 axis {1.0f, 1.0f, 1.0f};
+  for (int i = 0; i < 8; ++i) {
+    axis = covariance * axis;
+    const float length {glm::length(axis)};
+    if (length < 1e-6f) break;
+    axis /= length;
+  }
+  float min_t {0.0f};
+  float max_t {0.0f};
+  for (const glm::vec3& texel : texels) {
+    min_t = std::min(min_t, glm::dot(texel - mean, axis));
+    max_t = std::max(max_t, glm::dot(texel - mean, axis));
+  }
+  glm::vec3 end_0 {mean + axis * max_t};
+  glm::vec3 end_1 {mean + axis * min_t};
+
+  /// Refine the endpoints with a least squares fit to the indices chosen for the quantized ones
+  std::uint16_t best_color_0 {packRgb565(end_0)};
+  std::uint16_t best_color_1 {packRgb565(end_1)};
+  std::array<std::uint32_t, 16> best_indices {};
+  float best_error {chooseBC1Indices(texels, best_color_0, best_color_1, best_indices)};
+  for (int iteration = 0; iteration < 2; ++iteration) {
+    constexpr std::array<float, 4> weights {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa {0.0f}, ab {0.0f}, bb {0.0f};
+    glm::vec3 ax {0.0f}, bx {0.0f};
+    for (size_t i = 0; i < texels.size(); ++i) {
+      const float a {weights[best_indices[i]]};
+      const float b {1.0f - a};
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+      ax += a * texels[i];
+      bx += b * texels[i];
+    }
+    const float determinant {aa * bb - ab * ab};
+    if (std::abs(determinant) < 1e-6f) break;
+    end_0 = (ax * bb - bx * ab) / determinant;
+    end_1 = (bx * aa - ax * ab) / determinant;
+    const std::uint16_t color_0 {packRgb565(end_0)};
+    const std::uint16_t color_1 {packRgb565(end_1)};
+    std::array<std::uint32_t, 16> indices {};
+    const float error {chooseBC1Indices(texels, color_0, color_1, indices)};
+    if (error >= best_error) break;
+    best_color_0 = color_0;
+    best_color_1 = color_1;
+    best_indices = indices;
+    best_error   = error;
+  }
+
+  /// color_0 > color_1 selects the four color mode. Swapping the endpoints swaps indices 0 <-> 1 and 2 <-> 3.
+  if (best_color_0 < best_color_1) {
+    std::swap(best_color_0, best_color_1);
+    for (std::uint32_t& index : best_indices) { index ^= 1u; }
+  } else if (best_color_0 == best_color_1) {
+    best_indices.fill(0);
+  }
+  std::uint32_t packed_indices {0};
+  for (size_t i = 0; i < best_indices.size(); ++i) { packed_indices |= best_indices[i] << (2 * i); }
+  std::memcpy(destination, &best_color_0, 2);
+  std::memcpy(destination + 2, &best_color_1, 2);
+  std::memcpy(destination + 4, &packed_indices, 4);
+}
+
+static void encodeBC4Block(const std::array<float, 16>& values, std::byte* destination) {
+  /// Use the eight value mode (red_0 > red_1) spanning the range of the block, unless the block is flat
+  const auto [min_value, max_value] {std::ranges::minmax(values)};
+  const auto red_0 {static_cast<std::uint8_t>(std::lround(max_value))};
+  const auto red_1 {static_cast<std::uint8_t>(std::lround(min_value))};
+  std::uint64_t packed_indices {0};
+  if (red_0 > red_1) {
+    std::array<float, 8> palette {static_cast<float>(red_0), static_cast<float>(red_1)};
+    for (int i = 2; i < 8; ++i) {
+      palette[i] = (static_cast<float>(8 - i) * red_0 + static_cast<float>(i - 1) * red_1) / 7.0f;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+      std::uint64_t best_index {0};
+      for (std::uint64_t j = 1; j < palette.size(); ++j) {
+        if (std::abs(values[i] - palette[j]) < std::abs(values[i] - palette[best_index])) best_index = j;
+      }
+      packed_indices |= best_index << (3 * i);
+    }
+  }
+  destination[0] = static_cast<std::byte>(red_0);
+  destination[1] = static_cast<std::byte>(red_1);
+  for (int i = 0; i < 6; ++i) { destination[2 + i] = static_cast<std::byte>(packed_indices >> (8 * i) & 0xFF); }
+}
+
+std::vector<std::byte> help::compressImage(const unsigned char* rgb,
+                                           const GLsizei width,
+                                           const GLsizei height,
+                                           const BlockFormat format) {
+  PROFILE_ZONE("help::compressImage");
+  const BlockFormatInfo info {getBlockFormatInfo(format)};
+  const size_t stride {format == BC3_RGBA ? 4u : 3u};
+  std::vector<std::byte> compressed(getCompressedImageSize(format, width, height));
+  std::byte* destination {compressed.data()};
+  for (GLsizei block_y = 0; block_y < height; block_y += 4) {
+    for (GLsizei block_x = 0; block_x < width; block_x += 4) {
+      // Blocks overhanging the image (in levels smaller than 4x4) repeat its last row and column
+      const auto getTexel {[&](const int i, const int channel) {
+        const auto x {static_cast<size_t>(std::min(block_x + i % 4, width - 1))};
+        const auto y {static_cast<size_t>(std::min(block_y + i / 4, height - 1))};
+        const auto index {(y * width + x) * stride + channel};
+        return static_cast<float>(rgb[index]);
+      }};
+      if (format == BC1_RGB || format == BC1_SRGB || format == BC3_RGBA) {
+        // BC3 stores a BC4 block for alpha, followed by a BC1 block (always in four color mode) for color
+        std::array<glm::vec3, 16> texels {};
+        for (int i = 0; i < 16; ++i) { texels[i] = {getTexel(i, 0), getTexel(i, 1), getTexel(i, 2)}; }
+        if (format == BC3_RGBA) {
+          std::array<float, 16> alpha {};
+          for (int i = 0; i < 16; ++i) { alpha[i] = getTexel(i, 3); }
+          encodeBC4Block(alpha, destination);
+        }
+        encodeBC1Block(texels, destination + (format == BC3_RGBA ? 8 : 0));
+      } else {
+        for (std::uint32_t channel = 0; channel < info.num_channels; ++channel) {
+          std::array<float, 16> values {};
+          for (int i = 0; i < 16; ++i) { values[i] = getTexel(i, static_cast<int>(channel)); }
+          encodeBC4Block(values, destination + 8 * channel);
+        }
+      }
+      destination += info.block_size;
+    }
+  }
+  return compressed;
+}
+
+/**
+ * Builds a Basic Data Format Descriptor for a BCn format, with one sample per 64-bit channel block.
+ */
+static std::vector<std::uint32_t> getKtx2DataFormatDescriptor(const BlockFormatInfo& info) {
+  const std::uint32_t block_size {24 + 16 * info.num_channels};
+  std::vector<std::uint32_t> descriptor {
+    4 + block_size,                                     // total size
+    0,                                                  // vendor Khronos, descriptor type basic
+    2 | block_size << 16,                               // version 1.3, block size
+    info.dfd_color_model | 1u << 8 | static_cast<std::uint32_t>(info.dfd_transfer) << 16, // BT.709 primaries
+    3 | 3 << 8,                                         // 4x4 texel blocks
+    info.block_size,                                    // bytes per plane
+    0
+  };
+  for (std::uint32_t channel = 0; channel < info.num_channels; ++channel) {
+    // BC3 starts with its alpha block (KHR_DF_CHANNEL_BC3_ALPHA), followed by its color block
+    const std::uint32_t channel_id {info.dfd_color_model == 130 ? (channel == 0 ? 15u : 0u) : channel};
+    descriptor.insert(descriptor.end(), {64 * channel | 63 << 16 | channel_id << 24, 0, 0, 0xFFFFFFFF});
+  }
+  return descriptor;
+}
+
+bool help::writeKtx2(const std::string& path,
+                     const BlockFormat format,
+                     const GLsizei width,
+                     const GLsizei height,
+                     const std::span<const std::vector<std::byte>> levels) {
+  const BlockFormatInfo info {getBlockFormatInfo(format)};
+  const std::vector<std::uint32_t> descriptor {getKtx2DataFormatDescriptor(info)};
+  Ktx2Header header {};
+  std::ranges::copy(KTX2_IDENTIFIER, header.identifier);
+  header.vk_format       = info.vk_format;
+  header.type_size       = 1;
+  header.pixel_width     = static_cast<std::uint32_t>(width);
+  header.pixel_height    = static_cast<std::uint32_t>(height);
+  header.face_count      = 1;
+  header.level_count     = static_cast<std::uint32_t>(levels.size());
+  header.dfd_byte_offset = static_cast<std::uint32_t>(sizeof(header) + levels.size() * sizeof(Ktx2LevelIndex));
+  header.dfd_byte_length = static_cast<std::uint32_t>(descriptor.size() * sizeof(std::uint32_t));
+
+  /// Level data is stored from the smallest level to the largest, each aligned to the block size
+  std::vector<Ktx2LevelIndex> level_index(levels.size());
+  std::uint64_t offset {header.dfd_byte_offset + header.dfd_byte_length};
+  for (size_t level = levels.size(); level-- > 0;) {
+    offset = (offset + info.block_size - 1) / info.block_size * info.block_size;
+    level_index[level] = {offset, levels[level].size(), levels[level].size()};
+    offset += levels[level].size();
+  }
+
+  std::ofstream file {path, std::ios::binary | std::ios::trunc};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(level_index.data()), std::ssize(level_index) * sizeof(Ktx2LevelIndex));
+  file.write(reinterpret_cast<const char*>(descriptor.data()), header.dfd_byte_length);
+  for (size_t level = levels.size(); level-- > 0;) {
+    const std::vector<char> padding(level_index[level].byte_offset - static_cast<std::uint64_t>(file.tellp()));
+    file.write(padding.data(), std::ssize(padding));
+    file.write(reinterpret_cast<const char*>(levels[level].data()), std::ssize(levels[level]));
+  }
+  return static_cast<bool>(file);
+}
+
+std::vector<std::span<const std::byte>> help::readKtx2(const std::span<const std::byte> file,
+                                                       const BlockFormat format,
+                                                       const GLsizei width,
+                                                       const GLsizei height) {
+  Ktx2Header header {};
+  if (file.size() < sizeof(header)) return {};
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (!std::ranges::equal(header.identifier, KTX2_IDENTIFIER)
+      || header.vk_format != getBlockFormatInfo(format).vk_format
+      || header.pixel_width != static_cast<std::uint32_t>(width)
+      || header.pixel_height != static_cast<std::uint32_t>(height)
+      || header.level_count == 0
+      || header.supercompression_scheme != 0
+      || file.size() < sizeof(header) + header.level_count * sizeof(Ktx2LevelIndex)) {
+    return {};
+  }
+  std::vector<std::span<const std::byte>> levels;
+  for (std::uint32_t level = 0; level < header.level_count; ++level) {
+    Ktx2LevelIndex index {};
+    std::memcpy(&index, file.data() + sizeof(header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+    const size_t expected_size {getCompressedImageSize(format,
+                                                       std::max(width >> level, 1),
+                                                       std::max(height >> level, 1))};
+    if (index.byte_length != expected_size || index.byte_offset > file.size()
+        || index.byte_length > file.size() - index.byte_offset) {
+      return {};
+    }
+    levels.push_back(file.subspan(index.byte_offset, index.byte_length));
+  }
+  return levels;
+}
+
+std::string help::getCompressedTexturePath(const std::string& source_path) {
+  return std::filesystem::path(source_path).replace_extension(".ktx2").string();
+}
+
+void help::bakeCompressedTextures(const std::span<const std::string> source_paths,
+                                  const std::span<const std::string> alpha_paths,
+                                  const std::span<const std::string> baked_paths,
+                                  const BlockFormat format,
+                                  const GLsizei width,
+                                  const GLsizei height,
+                                  const GLsizei num_levels,
+                                  const MipFilter filter) {
+  PROFILE_ZONE("help::bakeCompressedTextures");
+  /// Collect the layers whose baked file is missing, older than any of its sources, or does not match
+  std::vector<size_t> stale_layers;
+  for (size_t i = 0; i < source_paths.size(); ++i) {
+    std::error_code error;
+    auto source_time {std::filesystem::last_write_time(source_paths[i], error)};
+    if (error) continue; // nothing to bake from, fill3DTextureLayersCompressed() reports the missing file
+    if (!alpha_paths.empty()) {
+      const auto alpha_time {std::filesystem::last_write_time(alpha_paths[i], error)};
+      if (error) continue;
+      source_time = std::max(source_time, alpha_time);
+    }
+    const auto baked_time {std::filesystem::last_write_time(baked_paths[i], error)};
+    if (error || baked_time < source_time
+        || std::ssize(readKtx2(MappedFile {baked_paths[i]}.data(), format, width, height)) < num_levels) {
+      stale_layers.push_back(i);
+    }
+  }
+  std::ranges::sort(stale_layers, {}, [&](const size_t i) { return baked_paths[i]; });
+  stale_layers.erase(std::ranges::unique(stale_layers, {}, [&](const size_t i) { return baked_paths[i]; }).begin(),
+                     stale_layers.end());
+  if (stale_layers.empty()) return;
+
+  const auto start_time {std::chrono::steady_clock::now()};
+  const GLsizei num_channels {format == BC3_RGBA ? 4 : 3};
+  std::vector<std::string> errors(stale_layers.size());
+  help::parallelFor(stale_layers.size(), [&](const size_t job) {
+    const size_t i {stale_layers[job]};
+    std::vector<unsigned char> pixels;
+    errors[job] = loadImage(source_paths[i], alpha_paths.empty() ? std::string {} : alpha_paths[i], width, height,
+                            pixels);
+    if (!errors[job].empty()) return;
+    std::vector<std::vector<std::byte>> compressed_levels;
+    const std::vector<std::vector<unsigned char>> levels {generateMipLevels(pixels.data(),
+                                                                            width,
+                                                                            height,
+                                                                            num_channels,
+                                                                            num_levels,
+                                                                            filter)};
+    for (GLsizei level = 0; level < num_levels; ++level) {
+      compressed_levels.push_back(compressImage(levels[level].data(),
+                                                std::max(width >> level, 1),
+                                                std::max(height >> level, 1),
+                                                format));
+    }
+    const std::string& path {baked_paths[i]};
+    const std::string temporary_path {path + ".tmp"};
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    if (!writeKtx2(temporary_path, format, width, height, compressed_levels)) {
+      errors[job] = std::format("Failed to write '{}'.", temporary_path);
+    } else if (std::filesystem::rename(temporary_path, path, error); error) {
+      errors[job] = std::format("Failed to replace '{}'. Reason: '{}'", path, error.message());
+    }
+  });
+  for (const std::string& error : errors) {
+    if (!error.empty()) std::cerr << "WARNING (help::bakeCompressedTextures): " << error << std::endl;
+  }
+  std::cout << std::format("INFO (help::bakeCompressedTextures): Compressed {} textures in {:.1f} ms.",
+                           stale_layers.size(),
+                           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                     - start_time).count())
+            << std::endl;
+}
+
+void help::fill3DTextureLayersCompressed(const std::span<const std::string> baked_paths,
+                                         const wrap::Texture& texture,
+                                         const GLint first_layer,
+                                         const GLsizei width,
+                                         const GLsizei height,
+                                         const GLsizei num_levels,
+                                         const BlockFormat format) {
+  PROFILE_ZONE("help::fill3DTextureLayersCompressed");
+  const auto start_time {std::chrono::steady_clock::now()};
+  const GLenum internal_format {getBlockFormatInternalFormat(format)};
+  for (size_t i = 0; i < baked_paths.size(); ++i) {
+    const std::string& path {baked_paths[i]};
+    const MappedFile file {path};
+    const std::vector<std::span<const std::byte>> levels {readKtx2(file.data(), format, width, height)};
+    if (std::ssize(levels) < num_levels) {
+      glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION,
+                           GL_DEBUG_TYPE_ERROR,
+                           texture.id,
+                           GL_DEBUG_SEVERITY_MEDIUM,
+                           -1,
+                           std::format("(help::fill3DTextureLayersCompressed): Failed to read compressed {}x{} "
+                                       "texture from path '{}'.",
+                                       width,
+                                       height,
+                                       path).c_str());
+      continue;
+    }
+    for (GLsizei level = 0; level < num_levels; ++level) {
+      glCompressedTextureSubImage3D(texture.id,
+                                    level,
+                                    0,
+                                    0,
+                                    first_layer + static_cast<GLint>(i),
+                                    std::max(width >> level, 1),
+                                    std::max(height >> level, 1),
+                                    1,
+                                    internal_format,
+                                    static_cast<GLsizei>(levels[level].size()),
+                                    levels[level].data());
+    }
+  }
+  std::cout << std::format("INFO (help::fill3DTextureLayersCompressed): Loaded {} compressed images in {:.1f} ms.",
+                           baked_paths.size(),
+                           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                     - start_time).count())
+            << std::endl;
+}
@@ -0,0 +1,107 @@
+#ifndef TEMPLEGL_SRC_TEXTURE_COMPRESSION_HELPERS_H_
+#define TEMPLEGL_SRC_TEXTURE_COMPRESSION_HELPERS_H_
+
+#include "opengl_wrappers.h"
+#include "mipmap_helpers.h"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * Collects helper functions that compress textures to BCn block formats on the CPU, and store them in KTX2 files.
+ */
+namespace help {
+  enum BlockFormat {
+    BC1_RGB,  // 8 bytes per 4x4 block, RGB without alpha
+    BC1_SRGB, // same as BC1_RGB, but decoded as sRGB
+    BC3_RGBA, // 16 bytes per 4x4 block, RGB as in BC1_RGB plus alpha as in BC4_R
+    BC4_R,    // 8 bytes per 4x4 block, single channel (taken from red)
+    BC5_RG    // 16 bytes per 4x4 block, two channels (taken from red and green)
+  };
+
+  [[nodiscard]] GLenum getBlockFormatInternalFormat(BlockFormat format);
+
+  /**
+   * @returns   The size in bytes of an image of the given dimensions, after compression.
+   */
+  [[nodiscard]] size_t getCompressedImageSize(BlockFormat format, GLsizei width, GLsizei height);
+
+  /**
+   * Compresses an RGB8 (or RGBA8) image. Endpoints are fit along the principal axis of each block, and then refined
+   * with a least squares fit to the chosen indices.
+   *
+   * @param rgb     width * height * 3 bytes (4 for BC3_RGBA). Blocks overhanging the image repeat its last row and
+   *                column.
+   *
+   * @returns   getCompressedImageSize() bytes.
+   */
+  [[nodiscard]] std::vector<std::byte> compressImage(const unsigned char* rgb,
+                                                     GLsizei width,
+                                                     GLsizei height,
+                                                     BlockFormat format);
+
+  /**
+   * Writes a KTX2 file holding a single 2D texture, without supercompression.
+   *
+   * @param levels  The compressed data of every mip level, starting with the full resolution one.
+   *
+   * @returns   Whether the file was written successfully.
+   */
+  bool writeKtx2(const std::string& path,
+                 BlockFormat format,
+                 GLsizei width,
+                 GLsizei height,
+                 std::span<const std::vector<std::byte>> levels);
+
+  /**
+   * Validates the contents of a KTX2 file written by writeKtx2() against the expected format and dimensions.
+   *
+   * @returns   The data of every mip level, starting with the full resolution one, pointing into file. Empty if the
+   *            file does not match.
+   */
+  [[nodiscard]] std::vector<std::span<const std::byte>> readKtx2(std::span<const std::byte> file,
+                                                                 BlockFormat format,
+                                                                 GLsizei width,
+                                                                 GLsizei height);
+
+  /**
+   * @returns   The path of the KTX2 file baked from the given image file (same folder and name, .ktx2 extension).
+   */
+  [[nodiscard]] std::string getCompressedTexturePath(const std::string& source_path);
+
+  /**
+   * Bakes every layer to a KTX2 file, if that file is missing, older than any of its sources, or holds fewer mip levels
+   * or another format. Layers sharing a baked path are baked once. Decoding, mip generation and compression run in
+   * parallel (see parallelFor).
+   *
+   * @param source_paths    Paths to RGB or RGBA image files of the given dimensions.
+   * @param alpha_paths     Either empty, or one path per layer whose red channel becomes alpha (see loadImage). Must be
+   *                        given for BC3_RGBA, and only then.
+   * @param baked_paths     One path per layer, for example getCompressedTexturePath(source_path).
+   * @param num_levels      The number of mip levels to store, built with the given filter (see generateMipLevels).
+   */
+  void bakeCompressedTextures(std::span<const std::string> source_paths,
+                              std::span<const std::string> alpha_paths,
+                              std::span<const std::string> baked_paths,
+                              BlockFormat format,
+                              GLsizei width,
+                              GLsizei height,
+                              GLsizei num_levels,
+                              MipFilter filter);
+
+  /**
+   * Uploads the given KTX2 files to consecutive layers of a compressed 3D texture (or cube map), mapping each file and
+   * passing the data of its first num_levels mip levels straight to glCompressedTextureSubImage3D. Files that are
+   * missing or do not match are reported, and their layers are left unfilled.
+   */
+  void fill3DTextureLayersCompressed(std::span<const std::string> baked_paths,
+                                     const wrap::Texture& texture,
+                                     GLint first_layer,
+                                     GLsizei width,
+                                     GLsizei height,
+                                     GLsizei num_levels,
+                                     BlockFormat format);
+}
+#endif //TEMPLEGL_SRC_TEXTURE_COMPRESSION_HELPERS_H_